@@ -14,7 +14,7 @@
 
 /*  clip.c
  * 
- * Code for defining and clipping polygons to the viewport and near plane.
+ * Code for defining and clipping polygons to the viewport and near and far planes.
  * 
  */
 
@@ -30,6 +30,11 @@
 
 vpminx, vpmaxx, vpminy, vpmaxy;
 vpcenx, vpceny;
+vpfar 077777;
+
+/* width of the guard band on the left and right of the viewport.
+ * spans in it must still fit in the scan conversion tables */
+static vpgbx 0;
 
 defvp(minx, miny, maxx, maxy, updcen)
 {
@@ -41,6 +46,8 @@ defvp(minx, miny, maxx, maxy, updcen)
 	vpminy = miny;
 	vpmaxx = maxx;
 	vpmaxy = maxy;
+	vpgbx = (PMAXDIM - 2 - (maxx - minx)) >> 1;
+	if (vpgbx < 0) { vpgbx = 0; }
 	/* update center of projection */
 	if (updcen) {
 	    vpcenx = ((minx + maxx) >> 1) + 1;
@@ -52,9 +59,12 @@ static
 doclip(L, R, out, len, bound, comp, ocomp)
 int *L, *R, *out;
 {
+    extern int recip();
     register i, f, fh, fhp;
     
-    fhp = ((bound - L[comp]) << 15) / (R[comp] - L[comp]);
+    /* (bound - L) / (R - L) to 15 bits, the product can't overflow
+     * since the numerator is at most the denominator */
+    fhp = ((bound - L[comp]) * recip(R[comp] - L[comp])) >> 15;
     fh = fhp >> (15 - HI_P);
     f = fh >> HH_P;
     /* skip x and y */
@@ -111,14 +121,31 @@ int **v0, **v1;
 	return(ret);
 }
 
+static
+zclip(L, R, out, len, bound)
+register int *L, *R, *out;
+{
+    extern int recip();
+    register i, f;
+    
+    f = ((bound - L[2]) * recip(R[2] - L[2])) >> (30 - CLIP_P);
+    out[0] = L[0] + (f * (R[0] - L[0]) >> CLIP_P);
+    out[1] = L[1] + (f * (R[1] - L[1]) >> CLIP_P);
+    out[2] = bound;
+    for (i = 3; i < len; i++) {
+        out[i] = L[i] + (f * (R[i] - L[i]) >> CLIP_P);
+    }
+}
+
+/* 3d line clip against the near and far planes */
 static int
-lclip3(v0, v1, len)
+lclip3(v0, v1, len, min, max)
 int **v0, **v1;
 {
     /* must be static, the memory is used after function execution */
-    static int m[PVDIM];
+    static int m0[PVDIM];
+    static int m1[PVDIM];
     
-    int i, f;
     int ooo = 1; /* out of order */
     int ret = 0;
     int *L, *R;
@@ -135,19 +162,18 @@ int **v0, **v1;
     L = *Lp;
     R = *Rp;
     
-    if (R[2] < NEARZ) {
+    if ((R[2] < min) || (L[2] > max)) {
         return(NC);
     }
-    if (L[2] < NEARZ) {
-        ret  = !ooo;
-        *Lp  = m;
-        f    = ((NEARZ - L[2]) << CLIP_P) / (R[2] - L[2]);
-        m[0] = L[0] + (f * (R[0] - L[0]) >> CLIP_P);
-        m[1] = L[1] + (f * (R[1] - L[1]) >> CLIP_P);
-        m[2] = NEARZ;
-        for (i = 3; i < len; i++) {
-            m[i] = L[i] + (f * (R[i] - L[i]) >> CLIP_P);
-        }
+    if (L[2] < min) {
+        ret = !ooo;
+        zclip(L, R, m0, len, min);
+        *Lp = m0;
+    }
+    if (R[2] > max) {
+        ret =| ooo;
+        zclip(L, R, m1, len, max);
+        *Rp = m1;
     }
     return(ret);
 }
@@ -202,7 +228,7 @@ static int
 lclipz(v0, v1, len, min, max)
 int **v0, **v1;
 {
-    return(lclip3(v0, v1, len));
+    return(lclip3(v0, v1, len, min, max));
 }
 
 extern int
@@ -237,13 +263,126 @@ extern int
 cpolyz(dst, src, len, num)
 int *dst, *src;
 {
-    return(pclip(dst, src, len, num, lclipz, 0, 0));
+    return(pclip(dst, src, len, num, lclipz, NEARZ, vpfar));
+}
+
+cobnds(b)
+register int *b;
+{
+    /* keep x * 2^fov from overflowing by shifting the bounds instead */
+    b[0] = vfov;
+    b[1] = 0;
+    if (b[0] > 12) {
+        b[1] = b[0] - 12;
+        b[0] = 12;
+    }
+    /* to cover rounding, the bounds a vertex is surely inside of are
+     * one pixel inside the viewport and those it is surely outside of
+     * one pixel outside of it */
+    b[2] = vpminx + 1 - vpcenx;
+    b[3] = vpmaxx - 1 - vpcenx;
+    b[4] = vpceny - vpminy - 1;
+    b[5] = vpceny - vpmaxy + 1;
+    b[6] = NEARZ;
+    b[7] = vpfar;
+    b[8] = vpminx - 1 - vpcenx;
+    b[9] = vpmaxx + 1 - vpcenx;
+    b[10] = vpceny - vpminy + 1;
+    b[11] = vpceny - vpmaxy - 1;
+}
+
+extern int
+ctestv(s, dim, len)
+register int *s;
+{
+    register int x, y;
+    int mnx, mxx, mny, mxy;
+    
+    mnx = mny =  077777777;
+    mxx = mxy = -077777777;
+    while (len--) {
+        x = s[0];
+        y = s[1];
+        if (x < mnx) { mnx = x; }
+        if (x > mxx) { mxx = x; }
+        if (y < mny) { mny = y; }
+        if (y > mxy) { mxy = y; }
+        s =+ dim;
+    }
+    if ((mxx < vpminx) || (mnx > vpmaxx) ||
+        (mxy < vpminy) || (mny > vpmaxy)) {
+        return(PCVO);
+    }
+    if ((mnx >= vpminx) && (mxx <= vpmaxx) &&
+        (mny >= vpminy) && (mxy <= vpmaxy)) {
+        return(PCVI);
+    }
+    /* y is always clipped per edge, only x needs the guard band */
+    if ((mnx >= (vpminx - vpgbx)) && (mxx <= (vpmaxx + vpgbx))) {
+        return(PCVG);
+    }
+    return(PCVX);
 }
 
 extern int
 ctestz(minz, maxz)
 {    
-    if (maxz <= NEARZ) { return(PCCB); } /* behind */
-    if (minz <  NEARZ) { return(PCCX); } /* crossing */
-    return(PCCI); /* in front */
+    if ((maxz <= NEARZ) || (minz > vpfar)) { return(PCCB); } /* outside */
+    if ((minz <  NEARZ) || (maxz > vpfar)) { return(PCCX); } /* crossing */
+    return(PCCI); /* in between */
+}
+
+/* classify a sphere against one side plane through the eye.
+ * inside is where p * 2^fov >= b * z, bo is the bound used for the
+ * outside test and bi the one used for the inside test. the length of
+ * the plane normal is overestimated so both tests stay conservative.
+ */
+static int
+sside(p, z, bo, bi, r, fs, sh)
+{
+    register int d, n;
+    
+    d = (p << fs) - ((bo * z) >> sh);
+    n = (1 << fs) + ((bo < 0 ? -bo : bo) >> sh) + 1;
+    if (d < -(r * n)) { return(PCCB); }
+    d = (p << fs) - ((bi * z) >> sh);
+    n = (1 << fs) + ((bi < 0 ? -bi : bi) >> sh) + 1;
+    if (d < (r * n)) { return(PCCX); }
+    return(PCCI);
+}
+
+extern int
+ctests(c, r)
+register int *c;
+{
+    register int res, s;
+    int x, y, z, fs, sh;
+    
+    x = c[0];
+    y = c[1];
+    z = c[2];
+    if (((z + r) <= NEARZ) || ((z - r) > vpfar)) { return(PCCB); }
+    res = PCCI;
+    if (((z - r) < NEARZ) || ((z + r) > vpfar)) { res = PCCX; }
+    
+    /* same bounds as cobnds(), the outside test widens them instead */
+    fs = vfov;
+    sh = 0;
+    if (fs > 12) {
+        sh = fs - 12;
+        fs = 12;
+    }
+    s = sside(x, z, vpminx - 1 - vpcenx, vpminx + 1 - vpcenx, r, fs, sh);
+    if (s == PCCB) { return(PCCB); }
+    if (s > res) { res = s; }
+    s = sside(-x, z, vpcenx - vpmaxx - 1, vpcenx - vpmaxx + 1, r, fs, sh);
+    if (s == PCCB) { return(PCCB); }
+    if (s > res) { res = s; }
+    s = sside(-y, z, vpminy - vpceny - 1, vpminy - vpceny + 1, r, fs, sh);
+    if (s == PCCB) { return(PCCB); }
+    if (s > res) { res = s; }
+    s = sside(y, z, vpceny - vpmaxy - 1, vpceny - vpmaxy + 1, r, fs, sh);
+    if (s == PCCB) { return(PCCB); }
+    if (s > res) { res = s; }
+    return(res);
 }
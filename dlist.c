@@ -0,0 +1,123 @@
+/*****************************************************************************/
+/*
+ * Early C implementation of an extra lite version of the PiSHi engine.
+ * 
+ *   by EMMIR 2018-2022
+ *   
+ *   YouTube: https://www.youtube.com/c/LMP88
+ *   
+ * This software is released into the public domain.
+ */
+/*****************************************************************************/
+
+#include "pl.h"
+
+/*  dlist.c
+ * 
+ * Display lists. While a list is being recorded odraw() stores the
+ * object with the model matrix and render state it would have been
+ * drawn with instead of drawing it. The matrix stack work is done once
+ * when recording, replaying only loads the stored matrices.
+ * Model matrices don't include the camera so moving it doesn't
+ * require the list to be recorded again.
+ * 
+ */
+
+/* list being recorded, checked by odraw() */
+struct PL_DL *dlrec NULL;
+
+dlbeg(d)
+struct PL_DL *d;
+{
+    extern uerror();
+    
+    if (dlrec) {
+        uerror(PERR_MISC, "dlist", "already recording");
+        return;
+    }
+    d->dlcnt = 0;
+    dlrec = d;
+}
+
+dlend()
+{
+    dlrec = NULL;
+}
+
+/* called by odraw() while recording */
+dlput(o)
+struct PL_OBJ *o;
+{
+    extern char *umemgt();
+    extern umemfr(), bufcpy(), mstget(), uerror();
+    register struct PL_DL *d;
+    register struct PL_DLE *e;
+    int n;
+
+    d = dlrec;
+    if (d->dlcnt >= d->dlcap) {
+        n = d->dlcap ? (d->dlcap << 1) : 8;
+        e = umemgt(n, sizeof(struct PL_DLE));
+        if (e == NULL) {
+            uerror(PERR_NO_MEM, "dlist", "no memory");
+            return;
+        }
+        if (d->dlent) {
+            bufcpy(e, d->dlent, d->dlcnt * sizeof(struct PL_DLE));
+            umemfr(d->dlent);
+        }
+        d->dlent = e;
+        d->dlcap = n;
+    }
+    e = &d->dlent[d->dlcnt++];
+    mstget(e->demat);
+    e->deobj = o;
+    e->derst = rastm;
+    e->decul = cullm;
+    e->defov = vfov;
+}
+
+dlcall(d)
+struct PL_DL *d;
+{
+    extern odraw(), mstpush(), mstpop(), mstld(), uerror();
+    register struct PL_DLE *e, *end;
+    int r, c, f;
+
+    if (dlrec) {
+        uerror(PERR_MISC, "dlist", "call while recording");
+        return;
+    }
+    r = rastm;
+    c = cullm;
+    f = vfov;
+    mstpush();
+    end = d->dlent + d->dlcnt;
+    for (e = d->dlent; e < end; e++) {
+        rastm = e->derst;
+        cullm = e->decul;
+        vfov  = e->defov;
+        mstld(e->demat);
+        odraw(e->deobj);
+    }
+    mstpop();
+    rastm = r;
+    cullm = c;
+    vfov  = f;
+}
+
+dldel(d)
+struct PL_DL *d;
+{
+    extern umemfr();
+
+    if (dlrec == d) {
+        dlrec = NULL;
+    }
+    if (d->dlent) {
+        umemfr(d->dlent);
+    }
+    d->dlent = NULL;
+    d->dlcnt = 0;
+    d->dlcap = 0;
+}
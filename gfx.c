@@ -21,6 +21,7 @@
 hres 0, vres 0;
 *pvideo NULL;
 dty *pdepth NULL;
+pscanm PCVX;
 
 #define ZP     8      /* z precision */
 #define TXMSK  ((1 << (PTLOG + PTLOG)) - 1)
@@ -30,6 +31,7 @@ dty *pdepth NULL;
 #define SPRND  (1 << (SP - 1))  /* rounding */
 
 static scan_miny, scan_maxy;
+static scan_gb; /* spans need to be clamped to the viewport */
 
 /* integer reserve for data locality */
 static short g3dresv[PMAXDIM /* x_L */
@@ -47,6 +49,32 @@ static int *xLc, *xRc;
 
 static short iv15[PMAXDIM];
 
+/* state of the screen while rendering to a texture */
+static ontgt 0;
+static int *svideo;
+static dty *sdepth;
+static shres, svres;
+static svp[6];
+static dty *tdepth NULL; /* depth buffer for texture targets */
+
+/* set scan conversion buffer offsets for a vertical resolution */
+static
+setscan(v)
+{
+    register int i;
+    
+	x_L  = g3dresv + v;
+    x_R  = x_L + v;
+    xLc  = x_R + v;
+    xRc  = xLc + v;
+    abuf = xRc + v;
+
+	for (i = 0; i < v; i++) {
+        xLc[i] =  077777777;
+        xRc[i] = -077777777;
+    }
+}
+
 pinit(video, h, v)
 int *video;
 {
@@ -70,17 +98,7 @@ int *video;
 	
 	pvideo = video;
 	
-	/* set buffer offsets */
-	x_L  = g3dresv + v;
-    x_R  = x_L + v;
-    xLc  = x_R + v;
-    xRc  = xLc + v;
-    abuf = xRc + v;
-
-	for (i = 0; i < v; i++) {
-        xLc[i] =  077777777;
-        xRc[i] = -077777777;
-    }
+	setscan(v);
 	
 	iv15[0] = 1;
 	for (i = 1; i < PMAXDIM; i++) {
@@ -107,6 +125,74 @@ pc()
     qbzero(pvideo, pdepth, hres * vres);
 }
 
+pcfill(rgb)
+{
+    register int *s0;
+    register dty *s1;
+    register unsigned n;
+    
+    s0 = pvideo;
+    s1 = pdepth;
+    n  = hres * vres;
+    while (n--) {
+        *s0++ = rgb;
+        *s1++ = 0;
+    }
+}
+
+ptgt(tex)
+struct PL_TEX *tex;
+{
+    extern char *umemgt();
+    extern uerror();
+    
+    if (tex == NULL) {
+        if (!ontgt) {
+            return;
+        }
+        ontgt  = 0;
+        pvideo = svideo;
+        pdepth = sdepth;
+        hres   = shres;
+        vres   = svres;
+        setscan(vres);
+        defvp(svp[0], svp[1], svp[2], svp[3], 0);
+        vpcenx = svp[4];
+        vpceny = svp[5];
+        return;
+    }
+    if (tex->texdat == NULL) {
+        uerror(PERR_MISC, "gfx", "target has no texels");
+        return;
+    }
+    if (tdepth == NULL) {
+        tdepth = umemgt(PTDIM * PTDIM, sizeof(dty));
+        if (tdepth == NULL) {
+            uerror(PERR_NO_MEM, "gfx", "no memory");
+            return;
+        }
+    }
+    if (!ontgt) {
+        ontgt  = 1;
+        svideo = pvideo;
+        sdepth = pdepth;
+        shres  = hres;
+        svres  = vres;
+        svp[0] = vpminx;
+        svp[1] = vpminy;
+        svp[2] = vpmaxx;
+        svp[3] = vpmaxy;
+        svp[4] = vpcenx;
+        svp[5] = vpceny;
+    }
+    pvideo = tex->texdat;
+    pdepth = tdepth;
+    hres   = PTDIM;
+    vres   = PTDIM;
+    setscan(PTDIM);
+    defvp(0, 0, PTDIM - 1, PTDIM - 1, 1);
+}
+
 /* scan convert polygon */
 static int
 pscan(stream, dim, len)
@@ -116,6 +202,7 @@ int *stream;
     extern int cpolyx();
     extern int cliney();
     int resv[PVDIM + PVDIM + (PPMAXV * PSTEX)];
+    int mode;
     short rdim;
     int *vA, *vB;
     register int x, y, dx, dy;
@@ -136,11 +223,19 @@ int *stream;
     /* clean scan tables */
     bufcpy(x_L, xLc, 2 * vres * sizeof(int));
   
-    len = cpolyx(VS, stream, dim, len);
+    mode = pscanm;
+    pscanm = PCVX;
+    scan_gb = (mode == PCVG);
+    if (mode == PCVX) {
+        len = cpolyx(VS, stream, dim, len);
+    } else {
+        /* x is either inside the viewport or clamped per span */
+        VS = stream;
+    }
     while (len--) {
         vA = VS;
         vB = VS =+ dim;
-        if (!cliney(&vA, &vB, dim, vpminy, vpmaxy)) {
+        if ((mode != PCVI) && !cliney(&vA, &vB, dim, vpminy, vpmaxy)) {
             continue;
         }
         x  = *vA++;
@@ -175,8 +270,17 @@ int *stream;
         /* make sure to round! */
         x  = (x  << SP) + SPRND;
         y  = (y  << SP) + SPRND;
-        dx = (dx << SP) * imjr >> 15;
-        dy = (dy << SP) * imjr >> 15;
+        /* truncate toward zero so the last step can't overshoot the end */
+        if (dx < 0) {
+            dx = -((-dx << SP) * imjr >> 15);
+        } else {
+            dx = (dx << SP) * imjr >> 15;
+        }
+        if (dy < 0) {
+            dy = -((-dy << SP) * imjr >> 15);
+        } else {
+            dy = (dy << SP) * imjr >> 15;
+        }
         do {
             sx = x >> SP;
             sy = y >> SP;
@@ -204,6 +308,30 @@ int *stream;
     return(scan_miny >= scan_maxy);
 }
 
+/* clamp a span to the viewport when drawing in the guard band,
+ * returns how many pixels were cut from the left, -1 if none are left */
+static int
+gbclip(beg, len)
+int *beg, *len;
+{
+    register b, n, cut;
+    
+    b = *beg;
+    n = *len;
+    cut = 0;
+    if (b < vpminx) {
+        cut = vpminx - b;
+        n =- cut;
+        b = vpminx;
+    }
+    if ((b + n) > vpmaxx) {
+        n = vpmaxx - b;
+    }
+    *beg = b;
+    *len = n;
+    return((n < 0) ? -1 : cut);
+}
+
 pfpoly(stream, len, rgb)
 int *stream;
 {
@@ -218,15 +346,21 @@ int *stream;
     miny = scan_miny;
     maxy = scan_maxy;
     pos  = miny * hres;
-    while (miny <= maxy) {
+    for (; miny <= maxy; miny++, pos =+ hres) {
         beg  = x_L[miny];
-        pbg  = pos + beg;
-        vbuf = pvideo + pbg;
-        zbuf = pdepth + pbg;
         len  = x_R[miny] - beg;
         yt   = (miny << ATTRB);
         sz   = abuf[yt];
         dz   = (short)(abuf[yt + 1] - sz) * iv15[len] >> 15;
+        if (scan_gb) {
+            if ((pbg = gbclip(&beg, &len)) < 0) {
+                continue;
+            }
+            sz =+ dz * pbg;
+        }
+        pbg  = pos + beg;
+        vbuf = pvideo + pbg;
+        zbuf = pdepth + pbg;
 
         do {
             if (*zbuf < sz) {
@@ -237,15 +371,14 @@ int *stream;
             vbuf++;
             zbuf++;
         } while (len--);
-        /* next scanline */
-        miny++;
-        pos =+ hres;
     }
 }
 
-ptpoly(stream, len, texels)
+/* textured fill, texels of the value PTKEY are left out if key is set */
+static
+tpoly(stream, len, texels, key)
 int *stream;
-register int len, *texels;
+register int *texels;
 {
     int miny, maxy;
     int pos, beg, pbg;
@@ -255,16 +388,14 @@ register int len, *texels;
     short du, dv, dz;
     register short su, sv, sz;
     register short dlen;
+    register int t;
     
     if (pscan(stream, PSTEX, len)) { return; }
     miny = scan_miny;
     maxy = scan_maxy;
     pos  = miny * hres;
-    while (miny <= maxy) {
+    for (; miny <= maxy; miny++, pos =+ hres) {
         beg  = x_L[miny];
-        pbg  = pos + beg;
-        vbuf = pvideo + pbg;
-        zbuf = pdepth + pbg;
         len  = x_R[miny] - beg;
         dlen = iv15[len];
         yt   = (miny << ATTRB);
@@ -275,6 +406,37 @@ register int len, *texels;
         du   = (short)(abuf[yt + 3] - su) * dlen >> 15;
         sv   = abuf[yt + 4];
         dv   = (short)(abuf[yt + 5] - sv) * dlen >> 15;
+        if (scan_gb) {
+            if ((dlen = gbclip(&beg, &len)) < 0) {
+                continue;
+            }
+            sz  =+ dz * dlen;
+            su  =+ du * dlen;
+            sv  =+ dv * dlen;
+        }
+        pbg  = pos + beg;
+        vbuf = pvideo + pbg;
+        zbuf = pdepth + pbg;
+        /* the test for the key is kept out of the plain loop */
+        if (key) {
+            while (len-- >= 0) {
+                if (*zbuf < sz) {
+                    su =& TXMSK;
+                    sv =& TXMSK;
+                    t = texels[(su >> PTLOG) | (sv & (~(PTDIM - 1)))];
+                    if (t != PTKEY) {
+                        *zbuf = sz;
+                        *vbuf = t;
+                    }
+                }
+                su =+ du;
+                sv =+ dv;
+                sz =+ dz;
+                vbuf++;
+                zbuf++;
+            }
+            continue;
+        }
         while (len-- >= 0) {
             if (*zbuf < sz) {
                 *zbuf = sz;
@@ -288,9 +450,17 @@ register int len, *texels;
             vbuf++;
             zbuf++;
         }
-
-        /* next scanline */
-        miny++;
-        pos =+ hres;
     }
 }
+
+ptpoly(stream, len, texels)
+int *stream, *texels;
+{
+    tpoly(stream, len, texels, 0);
+}
+
+pkpoly(stream, len, texels)
+int *stream, *texels;
+{
+    tpoly(stream, len, texels, 1);
+}
@@ -0,0 +1,157 @@
+/*****************************************************************************/
+/*
+ * Early C implementation of an extra lite version of the PiSHi engine.
+ * 
+ *   by EMMIR 2018-2022
+ *   
+ *   YouTube: https://www.youtube.com/c/LMP88
+ *   
+ * This software is released into the public domain.
+ */
+/*****************************************************************************/
+
+#include "pl.h"
+
+/*  img.c
+ * 
+ * Object images. An object in the compact form is written into one
+ * block of memory that refers to its own parts by offsets from the
+ * start, so the block can be loaded or mapped from a file as it is and
+ * used directly without converting or allocating anything.
+ * 
+ */
+
+/* round up to a multiple of the size of an int */
+#define IALIGN(x) (((x) + sizeof(int) - 1) & ~(sizeof(int) - 1))
+
+/* fill in the header of the image of a compact object,
+ * returns the size of its pool without padding */
+static int
+imlay(o, h)
+register struct PL_OBJ *o;
+register struct PL_IMG *h;
+{
+    register i, n;
+    
+    n = 0;
+    for (i = 0; i < o->np; i++) {
+        n =+ o->cply[i].cpnv;
+    }
+    h->immag = PIMAGIC;
+    h->imver = PIVERS;
+    h->imnc  = o->nc;
+    h->imnp  = o->np;
+    h->imnck = o->nck;
+    h->imntx = o->ntx;
+    for (i = 0; i < 3; i++) {
+        h->imcen[i] = o->bcen[i];
+    }
+    h->imrad = o->brad;
+    /* largest alignment first */
+    h->imck = IALIGN(sizeof(struct PL_IMG));
+    h->imtx = h->imck + IALIGN(o->nck * sizeof(struct PL_CHK));
+    h->impl = h->imtx + IALIGN(o->ntx * sizeof(int));
+    h->imcv = h->impl + IALIGN(o->np * sizeof(struct PL_CPLY));
+    h->impo = h->imcv + IALIGN(o->nc * 3 * sizeof(short));
+    h->imsiz = h->impo + IALIGN(n * PPOLY_VLEN);
+    return(n * PPOLY_VLEN);
+}
+
+extern int
+osize(o)
+struct PL_OBJ *o;
+{
+    extern int ocmpk();
+    struct PL_IMG h;
+    
+    if (!ocmpk(o)) return(0);
+    imlay(o, &h);
+    return(h.imsiz);
+}
+
+extern int
+osave(o, buf)
+register struct PL_OBJ *o;
+char *buf;
+{
+    extern int ocmpk();
+    extern bufcpy(), bufset(), uerror();
+    register struct PL_IMG *h;
+    register int *id;
+    register i;
+    int n;
+    
+    if (!ocmpk(o)) {
+        uerror(PERR_MISC, "img", "object can't be saved");
+        return(0);
+    }
+    h = buf;
+    n = imlay(o, h);
+    /* keep the padding from holding whatever was in the buffer */
+    bufset(buf + sizeof(struct PL_IMG), 0,
+           h->imsiz - sizeof(struct PL_IMG));
+    bufcpy(buf + h->imck, o->ck, o->nck * sizeof(struct PL_CHK));
+    id = buf + h->imtx;
+    for (i = 0; i < o->ntx; i++) {
+        id[i] = o->txtab[i]->txid;
+    }
+    bufcpy(buf + h->impl, o->cply, o->np * sizeof(struct PL_CPLY));
+    bufcpy(buf + h->imcv, o->cvtx, o->nc * 3 * sizeof(short));
+    bufcpy(buf + h->impo, o->cpool, n);
+    return(h->imsiz);
+}
+
+extern int
+omap(o, buf, tx)
+register struct PL_OBJ *o;
+char *buf;
+struct PL_TEX **tx;
+{
+    extern odel(), uerror();
+    register struct PL_IMG *h;
+    register i;
+    
+    h = buf;
+    if (h->immag != PIMAGIC) {
+        if (h->immag == PIMAGRV) {
+            uerror(PERR_MISC, "img", "image has wrong byte order");
+        } else {
+            uerror(PERR_MISC, "img", "not an object image");
+        }
+        return(0);
+    }
+    if (h->imver != PIVERS) {
+        uerror(PERR_MISC, "img", "unsupported image version");
+        return(0);
+    }
+    if ((h->imntx > 0) && (tx == NULL)) {
+        uerror(PERR_MISC, "img", "missing textures");
+        return(0);
+    }
+    odel(o);
+    o->nc    = h->imnc;
+    o->np    = h->imnp;
+    o->nck   = h->imnck;
+    o->ck    = h->imnck ? (buf + h->imck) : NULL;
+    o->cvtx  = buf + h->imcv;
+    o->cply  = buf + h->impl;
+    o->cpool = buf + h->impo;
+    o->txtab = tx;
+    o->ntx   = h->imntx;
+    for (i = 0; i < 3; i++) {
+        o->bcen[i] = h->imcen[i];
+    }
+    o->brad  = h->imrad;
+    o->oimg  = buf;
+    return(1);
+}
+
+extern int *
+oimtx(buf)
+char *buf;
+{
+    register struct PL_IMG *h;
+    
+    h = buf;
+    return(buf + h->imtx);
+}
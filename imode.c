@@ -21,17 +21,25 @@
 static struct PL_OBJ p; /* product */
 static struct PL_OBJ wc;
 
-static vtx[POMAXV];             /* temp storage for vertices */
-static struct PL_POLY ply[POMAXV / 4]; /* temp storage for polygons */
+/* objects larger than POMAXV vertices are split into chunks by oprep().
+ * the temp storage grows as needed and becomes the object made by imend() */
+static int *vtx NULL;             /* temp storage for vertices */
+static struct PL_POLY *ply NULL;  /* temp storage for polygons */
+static vcap 0;   /* ints allocated for vtx */
+static pcap 0;   /* polygons allocated */
+static struct PL_VH vh; /* welds vertices entered more than once */
 
 static ptype PTRIS;
 static nv 0;     /* entered so far */
 static np 0;     /* entered so far */
 static struct PL_TEX *curtex NULL;
-static cverts[4];
+static cverts[PPMAXE];
 static vnum 0;
-static ctexc[2 * 4];
+static ctexc[2 * PPMAXE];
 static tnum 0;
+static strip 0;  /* triangles made so far by the current strip */
+static strm 0;   /* drawing primitives as they are made, see imstrm() */
+static struct PL_POLY sply; /* polygon being drawn when streaming */
 static cr 077;
 static cg 077;
 static cb 077;
@@ -41,75 +49,114 @@ static cv 0;
 static int
 addvtx(x, y, z)
 {
-	register i, v;
+    extern int agrow(), vhget(), umemtg();
+	register i, *v;
+	int tag;
 
-	for (i = 0; i < nv; i++) {
-	    v = i * PVLEN;
-        if ((vtx[v    ] == x) &&
-            (vtx[v + 1] == y) &&
-            (vtx[v + 2] == z)) {
-            return(i);
-        }
+	tag = umemtg(PMIMODE);
+	i = -1;
+	if (agrow(&vtx, &vcap, (nv + 1) * PVLEN, sizeof(int))) {
+	    i = vhget(&vh, vtx, nv, x, y, z);
+	}
+	umemtg(tag);
+	if (i < 0) {
+	    return(0);
 	}
-	v = nv * PVLEN;
-    vtx[v    ] = x;
-    vtx[v + 1] = y;
-    vtx[v + 2] = z;
-	return(nv++);
+	if (i == nv) {
+	    v = vtx + nv * PVLEN;
+        v[0] = x;
+        v[1] = y;
+        v[2] = z;
+        v[3] = 0;
+        nv++;
+	}
+	return(i);
 }
 
+/* make polygon of the first 'edges' vertices entered */
 static
-addply()
+addply(edges)
 {
-    extern bufset();
+    extern bufset(), pprim();
+    extern int agrow(), umemtg();
 	struct PL_POLY *t;
-    register i, b, edges;
+    register i, b, n;
+    int tag, ok;
 
-	t = &ply[np];
+	if (strm) {
+	    t = &sply;
+	} else {
+	    tag = umemtg(PMIMODE);
+	    ok = agrow(&ply, &pcap, np + 1, sizeof(struct PL_POLY));
+	    umemtg(tag);
+	    if (!ok) {
+	        return;
+	    }
+	    t = &ply[np];
+	}
 	bufset(t, 0, sizeof(struct PL_POLY));
 	t->tex = curtex;
-	edges = 3;
 	
-	if (ptype == PQUADS) {
-	    edges = 4;
-        /* check for a quad with two identical vertices,
-         * if it has any, turn it into a triangle
-         */
-        if (cverts[0] == cverts[1]) {
-            edges            = 3;
-            cverts[1]        = cverts[2];
-            ctexc[2 * 1    ] = ctexc[2 * 2];
-            ctexc[2 * 1 + 1] = ctexc[2 * 2 + 1];
-
-            cverts[2]        = cverts[3];
-            ctexc[2 * 2    ] = ctexc[2 * 3];
-            ctexc[2 * 2 + 1] = ctexc[2 * 3 + 1];
-        }
-        if (cverts[2] == cverts[3]) {
-            edges = 3;
-        }
-    }
-	
-    t->color = c18to24(cr << 12 | cg << 6 | cb << 0);
-    
+    /* leave out vertices identical to the one before them,
+     * a polygon with fewer than three left is dropped
+     */
+    n = 0;
 	for (i = 0; i < edges; i++) {
-		b = i * PPOLY_VLEN;
+		b = n * PPOLY_VLEN;
+		if ((n > 0) && (t->v[b - PPOLY_VLEN] == cverts[i])) {
+		    continue;
+		}
 		t->v[b    ] = cverts[i];
 		t->v[b + 1] = ctexc[2 * i];
 		t->v[b + 2] = ctexc[2 * i + 1];
+		n++;
+	}
+	if ((n > 1) && (t->v[(n - 1) * PPOLY_VLEN] == t->v[0])) {
+	    n--;
 	}
-	b = i * PPOLY_VLEN;
-	t->v[b    ] = cverts[0];
-	t->v[b + 1] = ctexc[0];
-	t->v[b + 2] = ctexc[1];
-	t->nv = edges;
+	if (n < 3) {
+	    return;
+	}
+	
+    t->color = c18to24(cr << 12 | cg << 6 | cb << 0);
+    
+	b = n * PPOLY_VLEN;
+	t->v[b    ] = t->v[0];
+	t->v[b + 1] = t->v[1];
+	t->v[b + 2] = t->v[2];
+	t->nv = n;
 	
+	if (strm) {
+	    pprim(t->v, n, t->tex, t->color);
+	    return;
+	}
 	np++;
 }
 
+/* ring slot that none of the vertices entered so far is in */
+static int
+rslot()
+{
+    register i, s;
+    
+    for (s = 0; s < PRING; s++) {
+        for (i = 0; (i < vnum) && (cverts[i] != s); i++);
+        if (i == vnum) break;
+    }
+    return(s);
+}
+
+static
+vmove(d, s)
+{
+    cverts[d] = cverts[s];
+    ctexc[2 * d] = ctexc[2 * s];
+    ctexc[2 * d + 1] = ctexc[2 * s + 1];
+}
+
 imbeg()
 {
-    extern umemfr();
+    extern umemfr(), vhclr();
     register i;
     
     if (p.c) {
@@ -128,19 +175,31 @@ imbeg()
     }
     p.p  = NULL;
     p.np = 0;
+    
+    if (p.ck) {
+        umemfr(p.ck);
+    }
+    p.ck  = NULL;
+    p.nck = 0;
 
 	nv = 0;
 	np = 0;
 	vnum = 0;
 	tnum = 0;
+	vhclr(&vh);
 }
 
 imtype(type)
 {
-	/* reset when primitive type is changed */
-	if (type != ptype) {
+    if ((ptype == PPOLYGON) && (vnum >= 3)) {
+        addply(vnum);
+    }
+	/* reset when primitive type is changed,
+	 * strips, fans and polygons also start over on every call */
+	if ((type != ptype) || (type >= PSTRIP)) {
 		vnum = 0;
 		tnum = 0;
+		strip = 0;
 	}
 	ptype = type;
 }
@@ -166,24 +225,65 @@ imtexc(u, v)
 
 imvtx(x, y, z)
 {
-	cverts[vnum++] = addvtx(x, y, z);
+    extern uerror(), pvtx();
+    
+    if (vnum >= PPMAXE) {
+        uerror(PERR_MISC, "imode", "too many vertices in polygon");
+        return;
+    }
+	if (strm) {
+	    /* the vertices of a primitive are never more than PRING - 1 */
+	    cverts[vnum] = rslot();
+	    pvtx(cverts[vnum++], x, y, z);
+	} else {
+	    cverts[vnum++] = addvtx(x, y, z);
+	}
 	ctexc[tnum++]  = cu;
 	ctexc[tnum++]  = cv;
 	switch (ptype) {
 		case PTRIS:
 			if (vnum == 3) {
-				addply();
+				addply(3);
 				vnum = 0;
 				tnum = 0;
 			}
 			break;
 		case PQUADS:
 			if (vnum == 4) {
-			    addply();
+			    addply(4);
 				vnum = 0;
 				tnum = 0;
 			}
 			break;
+		case PSTRIP:
+			if (vnum == 3) {
+			    /* every other triangle is reversed to keep the winding */
+			    if (strip & 1) {
+			        vmove(3, 0);
+			        vmove(0, 1);
+			        vmove(1, 3);
+			    }
+			    addply(3);
+			    if (!(strip & 1)) {
+			        vmove(0, 1);
+			    }
+			    vmove(1, 2);
+			    strip++;
+				vnum = 2;
+				tnum = 4;
+			}
+			break;
+		case PFAN:
+			if (vnum == 3) {
+			    addply(3);
+			    vmove(1, 2);
+				vnum = 2;
+				tnum = 4;
+			}
+			break;
+		case PPOLYGON:
+		    /* made by the next imtype() or imend() */
+		    break;
 		default:
 			vnum = 0;
 			tnum = 0;
@@ -191,12 +291,15 @@ imvtx(x, y, z)
 	}
 }
 
+/* the temp storage becomes the product, it is only copied to trim what
+ * growing by doubling left unused */
 imend()
 {
-    extern char *umemgt();
-    extern bufcpy(), uerror();
-    register i;
+    extern uerror(), oprep();
+    extern int asize(), umemtg();
+    int tag, ok;
 
+    imtype(ptype);
 	if ((nv == 0) || (np == 0)) {
 	    return;
 	}
@@ -205,33 +308,57 @@ imend()
         uerror(PERR_MISC, "imode", "end without beg v");
         return;
     }
-    p.c = umemgt(nv * PVLEN, sizeof(int));
-    if (p.c == NULL) { goto nomem; }
-    for (i = 0; i < (nv * PVLEN); i++) {
-        p.c[i] = vtx[i];
-    }
-    p.nc = nv;
     if (p.p) {
         uerror(PERR_MISC, "imode", "end without beg p");
         return;
     }
-    p.p = umemgt(np + 1, sizeof(struct PL_POLY));
-    if (p.p == NULL) { goto nomem; }
-    for (i = 0; i < np; i++) {
-        bufcpy(&p.p[i], &ply[i], sizeof(struct PL_POLY));
+    tag = umemtg(PMIMODE);
+    ok = asize(&vtx, &vcap, nv * PVLEN, sizeof(int)) &&
+         asize(&ply, &pcap, np + 1, sizeof(struct PL_POLY));
+    umemtg(tag);
+    if (!ok) {
+        return;
     }
+    p.c  = vtx;
+    p.nc = nv;
+    p.p  = ply;
     p.np = np;
-    return;
-nomem:
-    uerror(PERR_NO_MEM, "imode", "no memory");  
+    vtx  = NULL;
+    ply  = NULL;
+    vcap = 0;
+    pcap = 0;
+    tag = umemtg(PMIMODE);
+    oprep(&p);
+    umemtg(tag);
+}
+
+/* move the product to dst, leaving it empty */
+static
+imove(dst)
+struct PL_OBJ *dst;
+{
+    extern bufcpy(), bufset();
+    
+    bufcpy(dst, &p, sizeof(struct PL_OBJ));
+    bufset(&p, 0, sizeof(struct PL_OBJ));
+}
+
+imstrm(on)
+{
+    imtype(ptype);
+    strm = on;
+    vnum = 0;
+    tnum = 0;
+    strip = 0;
 }
 
 iminit()
 {
-    extern ocpy();
+    extern odel();
     
 	if (nv && np) {
-	    ocpy(&wc, &p);
+	    odel(&wc);
+	    imove(&wc);
 	}
 }
 
@@ -247,23 +374,5 @@ imdraw()
 imexport(dst)
 struct PL_OBJ *dst;
 {
-    extern char *umemgt();
-    extern bufcpy(), uerror();
-    register i;
-	
-	dst->c = umemgt(p.nc * PVLEN, sizeof(int));
-	if (dst->c == NULL) { goto nomem; }
-	for (i = 0; i < (p.nc * PVLEN); i++) {
-		dst->c[i] = p.c[i];
-	}
-	dst->nc = p.nc;
-	dst->p = umemgt(p.np, sizeof(struct PL_POLY));
-	if (dst->p == NULL) { goto nomem; }
-	for (i = 0; i < np; i++) {
-		bufcpy(&dst->p[i], &p.p[i], sizeof(struct PL_POLY));
-	}
-	dst->np = p.np;
-	return;
-nomem:
-    uerror(PERR_NO_MEM, "imode", "no memory");	
+    imove(dst);
 }
@@ -0,0 +1,237 @@
+/*****************************************************************************/
+/*
+ * Early C implementation of an extra lite version of the PiSHi engine.
+ * 
+ *   by EMMIR 2018-2022
+ *   
+ *   YouTube: https://www.youtube.com/c/LMP88
+ *   
+ * This software is released into the public domain.
+ */
+/*****************************************************************************/
+
+#include "pl.h"
+
+/*  impost.c
+ * 
+ * Impostors. An object is rendered into a texture once and then drawn
+ * as a single textured quad facing the viewer for as long as it is
+ * seen from roughly the same direction.
+ * 
+ */
+
+#define AXLEN   (PONE << 3) /* length of the axes used to probe the view */
+#define MAXFOV  18          /* largest fov psproj can handle */
+
+/* scale direction so its largest component has a length of 256 */
+static
+knorm(d, n)
+register int *d;
+{
+    register i, m, a;
+    
+    m = 0;
+    for (i = 0; i < n; i++) {
+        a = d[i];
+        if (a < 0) { a = -a; }
+        if (a > m) { m = a; }
+    }
+    while (m >= 040000000) {
+        m =>> 1;
+        for (i = 0; i < n; i++) {
+            d[i] =>> 1;
+        }
+    }
+    if (m == 0) {
+        return;
+    }
+    for (i = 0; i < n; i++) {
+        d[i] = (d[i] << 8) / m;
+    }
+}
+
+extern int
+ipinit(ip, thr)
+struct PL_IMP *ip;
+{
+    extern char *umemgt();
+    extern uerror(), bufset();
+    extern int umemtg();
+    int tag;
+    
+    bufset(ip, 0, sizeof(struct PL_IMP));
+    tag = umemtg(PMTEX);
+    ip->iptex.texdat = umemgt(PTDIM * PTDIM, sizeof(int));
+    umemtg(tag);
+    if (ip->iptex.texdat == NULL) {
+        uerror(PERR_NO_MEM, "impost", "no memory");
+        return(0);
+    }
+    ip->iptex.txflg = PTFKEY;
+    ip->ipthr = thr;
+    return(1);
+}
+
+ipdel(ip)
+struct PL_IMP *ip;
+{
+    extern umemfr();
+    
+    if (ip->iptex.texdat) {
+        umemfr(ip->iptex.texdat);
+    }
+    ip->iptex.texdat = NULL;
+    ip->ipok = 0;
+}
+
+/* render the object into the image of the impostor.
+ * c is the view space center, r the view space radius */
+static
+capture(ip, o, c, r)
+register struct PL_IMP *ip;
+struct PL_OBJ *o;
+register int *c;
+{
+    extern odraw(), ptgt(), pcfill();
+    struct PL_DL *rec;
+    int fov, ofov, p;
+    
+    /* use as much of the image as possible */
+    fov = vfov;
+    while ((fov < MAXFOV) && ((r << (fov + 1)) <= ((PTDIM / 2 - 1) * c[2]))) {
+        fov++;
+    }
+    p = (1 << (fov + 12)) / c[2];
+    
+    ptgt(&ip->iptex);
+    pcfill(PTKEY);
+    ofov = vfov;
+    vfov = fov;
+    /* center the object in the image */
+    vpcenx = (PTDIM >> 1) - ((c[0] * p + (1 << 11)) >> 12);
+    vpceny = (PTDIM >> 1) + ((c[1] * p + (1 << 11)) >> 12);
+    /* draw into the image even while a display list is recorded */
+    rec = dlrec;
+    dlrec = NULL;
+    odraw(o);
+    dlrec = rec;
+    vfov = ofov;
+    ptgt(NULL);
+    
+    /* size of the image at the depth of the object */
+    ip->iphsz = (PTDIM << 11) / p;
+}
+
+ipdraw(ip, o)
+register struct PL_IMP *ip;
+struct PL_OBJ *o;
+{
+    extern odraw(), oprep(), xfvecs(), pvpoly(), bufcpy(), dlput();
+    extern int ctestz(), mscl();
+    int ax[4 * PVLEN]; /* center and axes in object space */
+    int xa[4 * PVLEN]; /* center and axes in view space */
+    int key[6];
+    int q[5 * PSTEX];
+    register int *c, *a;
+    register i;
+    int j, s, r, h, d;
+    
+    if (!o || !ip->iptex.texdat) return;
+    
+    /* the image depends on the view, so a list records the object */
+    if (dlrec) {
+        dlput(o);
+        return;
+    }
+    /* the image can only be drawn textured */
+    if (rastm != PRTEX) {
+        odraw(o);
+        return;
+    }
+    if (o->brad == 0) {
+        oprep(o);
+    }
+    for (i = 0; i < 4; i++) {
+        a = ax + i * PVLEN;
+        a[0] = o->bcen[0];
+        a[1] = o->bcen[1];
+        a[2] = o->bcen[2];
+        if (i) {
+            a[i - 1] =+ AXLEN;
+        }
+    }
+    xfvecs(ax, xa, 4);
+    c = xa;
+    for (i = 1; i < 4; i++) {
+        a = xa + i * PVLEN;
+        a[0] =- c[0];
+        a[1] =- c[1];
+        a[2] =- c[2];
+    }
+    r = ((o->brad * mscl()) >> PP) + 1;
+    
+    /* not worth it when near, off to the side or large on screen */
+    if ((ctestz(c[2] - r, c[2] + r) != PCCI) ||
+        (c[0] > c[2]) || (-c[0] > c[2]) ||
+        (c[1] > c[2]) || (-c[1] > c[2]) ||
+        ((r << vfov) > ((PTDIM / 2 - 1) * c[2]))) {
+        odraw(o);
+        return;
+    }
+    
+    /* direction to the object in object space */
+    for (i = 0; i < 3; i++) {
+        a = xa + (i + 1) * PVLEN;
+        key[i] = a[0] * (c[0] >> 4) + a[1] * (c[1] >> 4) + a[2] * (c[2] >> 4);
+    }
+    knorm(key, 3);
+    
+    /* roll, measured with the axis that is the most across the view */
+    j = ip->ipkey[5];
+    if (!ip->ipok) {
+        j = 0;
+        for (i = 1; i < 3; i++) {
+            if ((key[i] < 0 ? -key[i] : key[i]) <
+                (key[j] < 0 ? -key[j] : key[j])) {
+                j = i;
+            }
+        }
+    }
+    a = xa + (j + 1) * PVLEN;
+    key[3] = a[0];
+    key[4] = a[1];
+    knorm(key + 3, 2);
+    key[5] = j;
+    
+    if (ip->ipok) {
+        d = 0;
+        for (i = 0; i < 5; i++) {
+            h = key[i] - ip->ipkey[i];
+            d =+ (h < 0 ? -h : h);
+        }
+        if (d > ip->ipthr) {
+            ip->ipok = 0;
+        }
+    }
+    if (!ip->ipok) {
+        capture(ip, o, c, r);
+        bufcpy(ip->ipkey, key, sizeof(key));
+        ip->ipok = 1;
+    }
+    
+    h = ip->iphsz;
+    s = (PTDIM - 1) << PTLOG;
+    a = q;
+    for (i = 0; i < 5; i++) {
+        /* corners clockwise from the top left, then the first again */
+        j = i & 3;
+        a[0] = c[0] + (((j == 1) || (j == 2)) ? h : -h);
+        a[1] = c[1] + ((j < 2) ? h : -h);
+        a[2] = c[2];
+        a[3] = ((j == 1) || (j == 2)) ? s : 0;
+        a[4] = (j < 2) ? 0 : s;
+        a =+ PSTEX;
+    }
+    /* known to be in front of the near plane */
+    pvpoly(q, PSTEX, 4, POCS, &ip->iptex, 0);
+}
@@ -37,7 +37,10 @@ eirpts(); /* enable interrupts */
 char *alloc();
 free();
 int heapa(); /* heap available */
-int heapu(); /* heap used */
+int heapu(); /* heap used by a tag, or by all of them if HTALL */
+int heaptg(); /* tag to account the next allocations to, returns the old */
+
+#define HTALL   -1
 
 int abs();
 
@@ -15,36 +15,273 @@
 #define HEAPBEG     0x600000
 #define HEAPEND     0xffffff
 #define HEAPSZ      (HEAPEND - HEAPBEG)
-static int hptr = 0;
+
+/* Blocks of up to 16 << (NCLASS - 1) bytes are cells of slabs, which are
+ * taken from the heap SLABSZ bytes at a time and shared by blocks of the
+ * same size class. A slab goes back to the heap as soon as none of its
+ * cells are in use. Larger blocks come from the heap itself, first fit
+ * from a free list kept in address order so neighboring free blocks can
+ * be merged.
+ */
+#define NCLASS      5    /* cells of 16, 32, 64, 128 and 256 bytes */
+#define SLABSZ      4096
+#define HTAGS       8    /* tags blocks can be accounted to */
+
+struct hdr {
+    struct hdr *hnxt; /* next free block, or slab of the cell */
+    int hsz;          /* size in units with the header, -1 - class if a cell */
+    int htag;         /* tag the block was allocated with */
+};
+
+/* at the start of a slab, after the header of its block */
+struct slab {
+    struct slab *snxt; /* next slab of the class with free cells */
+    struct hdr *scel;  /* cells that were freed */
+    char *snew;        /* cells that were never used start here */
+    int snuse;         /* cells in use */
+};
+
+#define HUNIT       (sizeof(struct hdr))
+#define SBLK(s)     ((struct hdr *) (s) - 1)
+
+static struct hdr hbase;          /* empty block the free list starts at */
+static struct hdr *hfree NULL;    /* where the next search starts */
+static struct slab *cslab[NCLASS]; /* slabs of each class with free cells */
+static int hused 0;               /* units of the heap in use */
+static int tused[HTAGS];          /* bytes in use by each tag */
+static int ctag 0;                /* tag of the blocks allocated next */
+
+static
+hinit()
+{
+    register struct hdr *h;
+    
+    h = (struct hdr *) HEAPBEG;
+    h->hsz = HEAPSZ / HUNIT;
+    h->hnxt = &hbase;
+    hbase.hnxt = h;
+    hbase.hsz = 0;
+    hfree = &hbase;
+}
+
+/* first fit from the heap, n is in units with the header. slabs are
+ * taken from the lowest addresses and other blocks from the highest
+ * so cells that stay in use don't split the heap */
+static struct hdr *
+hget(n, lo)
+register n;
+{
+    register struct hdr *p, *q;
+    struct hdr *s;
+    
+    if (hfree == NULL) {
+        hinit();
+    }
+    s = lo ? &hbase : hfree;
+    q = s;
+    for (p = q->hnxt; ; q = p, p = p->hnxt) {
+        if (p->hsz >= n) {
+            if (p->hsz == n) {
+                q->hnxt = p->hnxt;
+            } else if (lo) {
+                q->hnxt = p + n;
+                q->hnxt->hsz = p->hsz - n;
+                q->hnxt->hnxt = p->hnxt;
+                p->hsz = n;
+            } else {
+                /* hand out the end so the free list needn't change */
+                p->hsz =- n;
+                p =+ p->hsz;
+                p->hsz = n;
+            }
+            hfree = q;
+            hused =+ n;
+            return(p);
+        }
+        if (p == s) {
+            return(NULL);
+        }
+    }
+}
+
+/* return block to the heap, merging it with free neighbors */
+static
+hput(b)
+register struct hdr *b;
+{
+    register struct hdr *p;
+    
+    hused =- b->hsz;
+    for (p = hfree; !((b > p) && (b < p->hnxt)); p = p->hnxt) {
+        /* past the highest block, b is at either end */
+        if ((p >= p->hnxt) && ((b > p) || (b < p->hnxt))) {
+            break;
+        }
+    }
+    if ((b + b->hsz) == p->hnxt) {
+        b->hsz =+ p->hnxt->hsz;
+        b->hnxt = p->hnxt->hnxt;
+    } else {
+        b->hnxt = p->hnxt;
+    }
+    if ((p + p->hsz) == b) {
+        p->hsz =+ b->hsz;
+        p->hnxt = b->hnxt;
+    } else {
+        p->hnxt = b;
+    }
+    hfree = p;
+}
+
+/* cells of sz bytes left in slab s */
+static int
+sfree(s, sz)
+register struct slab *s;
+{
+    return((s->scel != NULL) ||
+           ((s->snew + sz) <= (char *) (SBLK(s) + SBLK(s)->hsz)));
+}
+
+/* cell of class c */
+static struct hdr *
+cell(c)
+{
+    register struct slab *s;
+    register struct hdr *h;
+    int sz;
+    
+    sz = HUNIT + (16 << c);
+    s = cslab[c];
+    if (s == NULL) {
+        h = hget(SLABSZ / HUNIT, 1);
+        if (h == NULL) {
+            return(NULL);
+        }
+        s = (struct slab *) (h + 1);
+        s->snxt = NULL;
+        s->scel = NULL;
+        s->snew = (char *) (s + 1);
+        s->snuse = 0;
+        cslab[c] = s;
+    }
+    if (s->scel) {
+        h = s->scel;
+        s->scel = h->hnxt;
+    } else {
+        h = (struct hdr *) s->snew;
+        s->snew =+ sz;
+    }
+    if (!sfree(s, sz)) {
+        cslab[c] = s->snxt;
+    }
+    s->snuse++;
+    h->hnxt = (struct hdr *) s;
+    h->hsz = -1 - c;
+    return(h);
+}
+
+/* return cell h of class c to its slab, and the slab to the heap when
+ * it is empty */
+static
+uncell(h, c)
+register struct hdr *h;
+{
+    register struct slab *s, **p;
+    int sz;
+    
+    sz = HUNIT + (16 << c);
+    s = (struct slab *) h->hnxt;
+    if (!sfree(s, sz)) {
+        s->snxt = cslab[c];
+        cslab[c] = s;
+    }
+    h->hnxt = s->scel;
+    s->scel = h;
+    if (--s->snuse == 0) {
+        for (p = &cslab[c]; *p != s; p = &(*p)->snxt);
+        *p = s->snxt;
+        hput(SBLK(s));
+    }
+}
 
 char *
 alloc(s)
 unsigned s;
 {
-    char *b;
+    register struct hdr *h;
+    register c;
+    int n;
     
-    if ((hptr + s) >= HEAPSZ) { return NULL; }
-    b = (char *) (HEAPBEG + hptr);
-    hptr =+ s;
-    return(b);
+    for (c = 0; (c < NCLASS) && (s > (16 << c)); c++);
+    if (c < NCLASS) {
+        h = cell(c);
+        n = HUNIT + (16 << c);
+    } else {
+        h = hget((s + HUNIT - 1) / HUNIT + 1, 0);
+        if (h != NULL) {
+            n = h->hsz * HUNIT;
+        }
+    }
+    if (h == NULL) {
+        return(NULL);
+    }
+    h->htag = ctag;
+    tused[ctag] =+ n;
+    return((char *) (h + 1));
 }
 
 free(p)
 char *p;
 {
-    /* NO-OP because I am lazy :) */
+    register struct hdr *h;
+    register c;
+    
+    if (p == NULL) {
+        return;
+    }
+    h = (struct hdr *) p - 1;
+    if (h->hsz < 0) {
+        c = -1 - h->hsz;
+        tused[h->htag] =- HUNIT + (16 << c);
+        uncell(h, c);
+        return;
+    }
+    tused[h->htag] =- h->hsz * HUNIT;
+    hput(h);
+}
+
+/* set the tag of the blocks allocated from now on, returns the old one */
+int
+heaptg(t)
+{
+    register o;
+    
+    o = ctag;
+    if ((t >= 0) && (t < HTAGS)) {
+        ctag = t;
+    }
+    return(o);
 }
 
 int
 heapa()
 {
-    return(HEAPEND - hptr);
+    return(HEAPSZ - hused * HUNIT);
 }
 
 int
-heapu()
+heapu(t)
 {
-    return(hptr);
+    register i, n;
+    
+    if ((t >= 0) && (t < HTAGS)) {
+        return(tused[t]);
+    }
+    n = 0;
+    for (i = 0; i < HTAGS; i++) {
+        n =+ tused[i];
+    }
+    return(n);
 }
 
 char *
@@ -16,10 +16,12 @@
 
 #include <stdio.h>
 
-/* cc68 -O -o prog.bin main.c glib.c gfx.c clip.c imode.c math.c pl.c */
+/* cc68 -O -o prog.bin main.c glib.c gfx.c clip.c imode.c math.c pl.c tex.c
+ *      impost.c scene.c dlist.c img.c mesh.c opt.c */
 static init();
 static int update();
 static display();
+static int maketex();
 
 /* special palette where the LS 3-bits is the inverse lookup key */
 static int pal[6] = {
@@ -82,11 +84,18 @@ main()
     exit(0);
 }
 
+/* cleared like calloc(), freed blocks are reused by alloc() */
 char *
 umemgt(n, esz)
 unsigned n, esz;
 {
-    return(alloc(n * esz));
+    register char *p;
+    
+    p = alloc(n * esz);
+    if (p) {
+        bufset(p, 0, n * esz);
+    }
+    return(p);
 }
 
 umemfr(p)
@@ -95,6 +104,12 @@ char *p;
     free(p);
 }
 
+int
+umemtg(t)
+{
+    return(heaptg(t));
+}
+
 uerror(id, modnm, msg)
 char *modnm, *msg;
 {
@@ -130,15 +145,19 @@ register unsigned size;
 static struct PL_OBJ *floor;
 static struct PL_OBJ *tcube;
 static struct PL_TEX tex;
+static struct PL_DL grid;
+static struct PL_NODE cube;
 static rot  1;
 static incv 0;
 static decv 0;
 static dir  1;
 
-static
-maketex()
+/* texture loader, called by the texture cache on first use */
+static int
+maketex(tx, chk)
+struct PL_TEX *tx;
+int *chk;
 {
-    static int chk[PTDIM * PTDIM];
     auto i, j, t;
     int c;
     
@@ -167,13 +186,15 @@ maketex()
     for (i = 0; i < (PTDIM * PTDIM); i++) {
         chk[i] = c18to24(chk[i]);
     }
-    tex.texdat = chk;
+    return(1);
 }
 
 static
 init()
 {
-    maketex();
+    auto i, j;
+    
+    tex.txload = maketex;
 
     imtex(&tex);
     tcube = genbox(CUSZ, CUSZ, CUSZ, PALL, 
@@ -190,8 +211,20 @@ init()
 	cullm  = PCBACK;
 	rastm  = PRTEX;
     
+    /* the tile grid never changes so it is recorded once */
+    dlbeg(&grid);
+    for (i = -GRSZ; i < GRSZ; i++) {
+        for (j = -GRSZ; j < GRSZ; j++) {
+            mstidt();
+            mtrans(0 + i * CUSZ, 0, 600 + j * CUSZ);
+            odraw(floor);
+        }
+    }
+    dlend();
+    sninit(&cube, tcube);
+    
     /* fixed camera for this demo */
-    defcam(-64, 100, 200, 0, 0);
+    defcam(-64, 100, 200, 0, 0, 0);
 }
 
 static int
@@ -224,7 +257,6 @@ display()
 {
     extern vdch, vdcv, tc;
     extern long dblbuf;
-    auto i = 0, j = 0;
     register int vsz;
     register char *ptr;
     register long vbase;
@@ -233,17 +265,12 @@ display()
         pvideo = (int*) dblbuf;
     }
     
+    tcfrm();
     /* clear viewport */
 	pc();
 
     /* draw tile grid */
-    for (i = -GRSZ; i < GRSZ; i++) {
-        for (j = -GRSZ; j < GRSZ; j++) {
-            mstidt();
-            mtrans(0 + i * CUSZ, 0, 600 + j * CUSZ);
-            odraw(floor);
-        }
-    }
+    dlcall(&grid);
     
     /* draw textured cube */
     mstidt();
@@ -253,7 +280,8 @@ display()
         mroty(decv >> 1);
     }
     mscale(PONE * (incv + 128) >> 8, PONE, PONE);
-    odraw(tcube);
+    snset(&cube);
+    sndraw(&cube);
 
     sync();
 
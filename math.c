@@ -41,16 +41,28 @@ int PL_sin[PTRIGMAX] = {
 int PL_cos[PTRIGMAX];
 
 static struct XF {
-    short tx, ty, tz;
-	unsigned int rx, ry;
+    int tx, ty, tz;
+    mty rot[9];
 } xf_vw; /* view transform */
 
+/* model+view concatenated, recomputed when either changes */
+static mty mvw[9];
+static int mvt[3];
+static xfdirt 1;
+
 static mty idt[16];
 static mty mdl[16];
 
-/* maximum matrix stack depth */
-#define MSTDEPTH   4
-static mty mstack[MSTDEPTH * 16];
+/* rounding for products of two and three fixed point values */
+#define RND1       (1 << (PP - 1))
+#define RND2       (1 << (PP + PP - 1))
+
+/* reciprocal tables, see recip() */
+#define RCPLOG     7
+static short rcptab[1 << RCPLOG];
+static char bitlen[256];
+
+static mty mstack[PMSTACK * 16];
 static mtop 0;
 
 pminit()
@@ -81,16 +93,82 @@ pminit()
     idt[15] = PONE;
     
     bufcpy(mdl, idt, sizeof(mty) * 16);
+    
+    /* 2^29 / m for the middle of each interval of 15 bit mantissas */
+    for (i = 0; i < (1 << RCPLOG); i++) {
+        rcptab[i] = (1 << 29) / (((1 << RCPLOG) + i << (14 - RCPLOG))
+                                 + (1 << (13 - RCPLOG)));
+    }
+    bitlen[0] = 0;
+    for (i = 1; i < 256; i++) {
+        bitlen[i] = bitlen[i >> 1] + 1;
+    }
 }
 
-defcam(x, y, z, rx, ry)
+/* 2^30 / z for z > 0 without dividing, the table gives the reciprocal of
+ * the normalized z to 8 bits and one newton step brings the relative
+ * error under 6.4e-5 for z below 2^16, above that the truncation of the
+ * result to an int dominates */
+int
+recip(z)
+register int z;
 {
+    register int m, y, e;
+    
+    if (z <= 1) {
+        return(1 << 30);
+    }
+    if (z >> 16) {
+        e = (z >> 24) ? (24 + bitlen[z >> 24]) : (16 + bitlen[z >> 16]);
+    } else {
+        e = (z >> 8) ? (8 + bitlen[z >> 8]) : bitlen[z];
+    }
+    /* 15 bit mantissa */
+    if (e > 15) {
+        m = z >> (e - 15);
+    } else {
+        m = z << (15 - e);
+    }
+    y = rcptab[(m >> (14 - RCPLOG)) & ((1 << RCPLOG) - 1)];
+    y =+ (y * (((1 << 29) - m * y) >> 8)) >> 21;
+    /* 2^30 / z = 2^29 / m * 2^(16 - e) */
+    if (e > 16) {
+        return(y >> (e - 16));
+    }
+    return(y << (16 - e));
+}
+
+defcam(x, y, z, rx, ry, rz)
+{
+    register mty *r;
+    int sx, cx, sy, cy, sz, cz;
+    
 	xf_vw.tx = -x;
 	xf_vw.ty = -y;
 	xf_vw.tz = -z;
 	
-    xf_vw.rx = (unsigned int) (PTRIGMAX - rx & PTRIGMSK);
-    xf_vw.ry = (unsigned int) (PTRIGMAX - ry & PTRIGMSK);
+    rx = PTRIGMAX - rx & PTRIGMSK;
+    ry = PTRIGMAX - ry & PTRIGMSK;
+    rz = PTRIGMAX - rz & PTRIGMSK;
+    cx = PL_cos[rx];
+    sx = PL_sin[rx];
+    cy = PL_cos[ry];
+    sy = PL_sin[ry];
+    cz = PL_cos[rz];
+    sz = PL_sin[rz];
+    
+    /* yaw, then pitch, then roll, rounded to the matrix precision */
+    r = xf_vw.rot;
+    r[0] = (cy * cz * PONE + sy * sx * sz + RND2) >> (PP + PP);
+    r[1] = (sy * sx * cz - cy * sz * PONE + RND2) >> (PP + PP);
+    r[2] = (-sy * cx + RND1) >> PP;
+    r[3] = (cx * sz + RND1) >> PP;
+    r[4] = (cx * cz + RND1) >> PP;
+    r[5] = sx;
+    r[6] = (sy * cz * PONE - cy * sx * sz + RND2) >> (PP + PP);
+    r[7] = (-cy * sx * cz - sy * sz * PONE + RND2) >> (PP + PP);
+    r[8] = (cy * cx + RND1) >> PP;
+    xfdirt = 1;
 }
 
 mstget(out)
@@ -101,7 +179,7 @@ mty *out;
 
 mstpush()
 {
-	if ((mtop + 1) >= MSTDEPTH) {
+	if ((mtop + 1) >= PMSTACK) {
 	    uerror(PERR_MISC, "math", "stack overflow");
 	}
 	mcpy(&mstack[(mtop + 1) * 16], mdl);
@@ -114,148 +192,369 @@ mstpop()
 	    uerror(PERR_MISC, "math", "stack underflow");
 	}
 	mcpy(mdl, &mstack[(mtop--) * 16]);
+	xfdirt = 1;
 }
 
 mstidt()
 {	
     mcpy(mdl, idt);
+    xfdirt = 1;
 }
 
 mstld(m)
 mty *m;
 {
     mcpy(mdl, m);
+    xfdirt = 1;
 }
 
 mstmul(m)
 mty *m;
 {
     mmul(mdl, m);
+    xfdirt = 1;
 }
 
+/* the operations below update the model matrix in place,
+ * giving the same result as mstmul() with the full matrix */
+
 mscale(x, y, z)
 {
-	mty mat[16];
-	
-	bufcpy(mat, idt, sizeof(mat));
-	
-	mat[0]  = x;
-	mat[5]  = y;
-	mat[10] = z;
-	mstmul(mat);
+    register i;
+    
+    for (i = 0; i < 4; i++) {
+        mdl[0 + i] = (x * mdl[0 + i]) >> PP;
+        mdl[4 + i] = (y * mdl[4 + i]) >> PP;
+        mdl[8 + i] = (z * mdl[8 + i]) >> PP;
+    }
+    xfdirt = 1;
 }
 
 mtrans(x, y, z)
 {
-    mty mat[16];
-    
-    bufcpy(mat, idt, sizeof(mat));
+    register i;
     
-	mat[12] = x;
-	mat[13] = y;
-	mat[14] = z;
-	mstmul(mat);
+    for (i = 0; i < 4; i++) {
+        mdl[12 + i] =+ ((x * mdl[0 + i]) >> PP) + ((y * mdl[4 + i]) >> PP)
+                     + ((z * mdl[8 + i]) >> PP);
+    }
+    xfdirt = 1;
 }
 
-mrotx(rx)
+/* rotate rows a and b of the model matrix by the angle with cosine c
+ * and sine s, only those two rows change */
+static
+mrot(a, b, c, s)
+register c, s;
 {
-    register cx, sx;
-    mty mat[16];
-      
-    bufcpy(mat, idt, sizeof(mat));
+    register i;
+    register mty *ra, *rb;
+    int t;
     
-    cx = PL_cos[rx & PTRIGMSK];
-    sx = PL_sin[rx & PTRIGMSK];
+    ra = &mdl[a << 2];
+    rb = &mdl[b << 2];
+    for (i = 0; i < 4; i++) {
+        t = ra[i];
+        ra[i] = ((c * t) >> PP) + ((s * rb[i]) >> PP);
+        rb[i] = ((-s * t) >> PP) + ((c * rb[i]) >> PP);
+    }
+    xfdirt = 1;
+}
 
-    mat[(1 << 2) + 1] = cx;
-    mat[(2 << 2) + 1] = -sx;
-    mat[(1 << 2) + 2] = sx;
-    mat[(2 << 2) + 2] = cx;
-    
-    mstmul(mat);
+mrotx(rx)
+{
+    mrot(1, 2, PL_cos[rx & PTRIGMSK], PL_sin[rx & PTRIGMSK]);
 }
 
 mroty(ry)
 {
-    register cy, sy;
-    mty mat[16];
-      
-    bufcpy(mat, idt, sizeof(mat));
-
-    cy = PL_cos[ry & PTRIGMSK];
-    sy = PL_sin[ry & PTRIGMSK];
-    
-    mat[(0 << 2) + 0] = cy;
-    mat[(2 << 2) + 0] = sy;
-    mat[(0 << 2) + 2] = -sy;
-    mat[(2 << 2) + 2] = cy;
-    
-    mstmul(mat);
+    mrot(2, 0, PL_cos[ry & PTRIGMSK], PL_sin[ry & PTRIGMSK]);
 }
 
 mrotz(rz)
 {
-    register cz, sz;
-    mty mat[16];
-    
-    bufcpy(mat, idt, sizeof(mat));
-      
-    cz = PL_cos[rz & PTRIGMSK];
-    sz = PL_sin[rz & PTRIGMSK];
-    
-    mat[(0 << 2) + 0] = cz;
-    mat[(1 << 2) + 0] = sz;
-    mat[(0 << 2) + 1] = -sz;
-    mat[(1 << 2) + 1] = cz;
+    mrot(1, 0, PL_cos[rz & PTRIGMSK], PL_sin[rz & PTRIGMSK]);
+}
+
+/* concatenate the model matrix with the camera so
+ * vertices only need a single multiply */
+static
+xfload()
+{
+    register i, j;
+    register mty *r;
+    int t[3];
     
-    mstmul(mat);
+    r = xf_vw.rot;
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 3; j++) {
+            mvw[i * 3 + j] = (mdl[(i << 2) + 0] * r[0 + j]
+                            + mdl[(i << 2) + 1] * r[3 + j]
+                            + mdl[(i << 2) + 2] * r[6 + j] + RND1) >> PP;
+        }
+    }
+    t[0] = mdl[12] + xf_vw.tx;
+    t[1] = mdl[13] + xf_vw.ty;
+    t[2] = mdl[14] + xf_vw.tz;
+    for (j = 0; j < 3; j++) {
+        mvt[j] = (t[0] * r[0 + j] + t[1] * r[3 + j] + t[2] * r[6 + j]
+                  + RND1) >> PP;
+    }
+    xfdirt = 0;
 }
 
 xfvecs(v, out, len)
 int *v, *out;
 {
-    register short sx, sy, cx, cy;
-    register short x, y, z, w;
-    register short xx, yy, zz;
-    short tx, ty, tz;
-    mty *m;
-
-    cx = PL_cos[xf_vw.rx];
-    sx = PL_sin[xf_vw.rx];
-    cy = PL_cos[xf_vw.ry];
-    sy = PL_sin[xf_vw.ry];
-
-    m = mdl;
-    
-	tx = xf_vw.tx + m[12];
-	ty = xf_vw.ty + m[13];
-	tz = xf_vw.tz + m[14];
+    register short x, y, z;
+    register mty *m;
+    int tx, ty, tz;
+
+    if (xfdirt) {
+        xfload();
+    }
+    m = mvw;
+    tx = mvt[0];
+    ty = mvt[1];
+    tz = mvt[2];
 
     while ((len--) > 0) {
         x = v[0];
         y = v[1];
         z = v[2];
 
-        xx = ((x * m[0] + y * m[4] + z * m[8])  >> PP) + tx;
-        yy = ((x * m[1] + y * m[5] + z * m[9])  >> PP) + ty;
-        zz = ((x * m[2] + y * m[6] + z * m[10]) >> PP) + tz;
-
-        /* yaw */
-        w  = (zz * sy + xx * cy) >> PP;
-        zz = (zz * cy - xx * sy) >> PP;
-        xx = w;
-
-        /* pitch */
-        w  = (yy * cx - zz * sx) >> PP;
-        zz = (yy * sx + zz * cx) >> PP;
-        yy = w;
+        out[0] = ((x * m[0] + y * m[3] + z * m[6]) >> PP) + tx;
+        out[1] = ((x * m[1] + y * m[4] + z * m[7]) >> PP) + ty;
+        out[2] = ((x * m[2] + y * m[5] + z * m[8]) >> PP) + tz;
+        out[3] = 0;
+        v   =+ PVLEN;
+        out =+ PVLEN;
+    }
+}
 
+/* transform and compute outcodes in one pass over the vertices,
+ * see cobnds() for the bounds. the input is either [x, y, z, 0] ints
+ * in v or [x, y, z] shorts in s */
+static
+xfcore(v, s, out, len, oc)
+int *v, *out;
+short *s;
+{
+    extern cobnds();
+    register short x, y, z;
+    register mty *m;
+    register int c;
+    int xx, yy, zz;
+    int tx, ty, tz;
+    int b[PCOBND];
+
+    if (xfdirt) {
+        xfload();
+    }
+    cobnds(b);
+    m = mvw;
+    tx = mvt[0];
+    ty = mvt[1];
+    tz = mvt[2];
+
+    for (; len > 0; len--, out =+ PVLEN) {
+        if (s) {
+            x = s[0];
+            y = s[1];
+            z = s[2];
+            s =+ 3;
+        } else {
+            x = v[0];
+            y = v[1];
+            z = v[2];
+            v =+ PVLEN;
+        }
+        if (out[3] == POCU) {
+            continue;
+        }
+
+        xx = ((x * m[0] + y * m[3] + z * m[6]) >> PP) + tx;
+        yy = ((x * m[1] + y * m[4] + z * m[7]) >> PP) + ty;
+        zz = ((x * m[2] + y * m[5] + z * m[8]) >> PP) + tz;
         out[0] = xx;
         out[1] = yy;
         out[2] = zz;
-        v   =+ PVLEN;
-        out =+ PVLEN;
+        
+        c = 0;
+        if (oc) {
+            if (zz < b[6]) { c = POCN; }
+            if (zz > b[7]) { c = POCF; }
+            xx =<< b[0];
+            yy =<< b[0];
+            /* the outside bounds are wider, only test them when needed */
+            if (xx < ((b[2] * zz) >> b[1])) {
+                c =| POCL;
+                if (xx < ((b[8] * zz) >> b[1])) { c =| POXL; }
+            }
+            if (xx > ((b[3] * zz) >> b[1])) {
+                c =| POCR;
+                if (xx > ((b[9] * zz) >> b[1])) { c =| POXR; }
+            }
+            if (yy > ((b[4] * zz) >> b[1])) {
+                c =| POCT;
+                if (yy > ((b[10] * zz) >> b[1])) { c =| POXT; }
+            }
+            if (yy < ((b[5] * zz) >> b[1])) {
+                c =| POCB;
+                if (yy < ((b[11] * zz) >> b[1])) { c =| POXB; }
+            }
+        }
+        out[3] = c;
+    }
+}
+
+xfcvec(v, out, len, oc)
+int *v, *out;
+{
+    xfcore(v, NULL, out, len, oc);
+}
+
+xfsvec(s, out, len, oc)
+short *s;
+int *out;
+{
+    xfcore(NULL, s, out, len, oc);
+}
+
+/* the eye is at -t * m^-1 and m^-1 is the transposed cofactor matrix
+ * over the determinant. the cofactors are scaled down to keep the
+ * products in range and the quotient is done in two steps so small
+ * determinants keep their precision */
+int
+xfeye(e)
+int *e;
+{
+    register mty *m;
+    register i, j;
+    int c[9], t[3];
+    int sc, mx, det, num, q;
+    
+    if (xfdirt) {
+        xfload();
+    }
+    m = mvw;
+    for (i = 0; i < 9; i++) {
+        if ((m[i] >= 040000) || (m[i] <= -040000)) { return(0); }
+    }
+    for (i = 0; i < 3; i++) {
+        t[i] = mvt[i];
+        if ((t[i] >= 0200000) || (t[i] <= -0200000)) { return(0); }
+    }
+    c[0] = m[4] * m[8] - m[5] * m[7];
+    c[1] = m[5] * m[6] - m[3] * m[8];
+    c[2] = m[3] * m[7] - m[4] * m[6];
+    c[3] = m[2] * m[7] - m[1] * m[8];
+    c[4] = m[0] * m[8] - m[2] * m[6];
+    c[5] = m[1] * m[6] - m[0] * m[7];
+    c[6] = m[1] * m[5] - m[2] * m[4];
+    c[7] = m[2] * m[3] - m[0] * m[5];
+    c[8] = m[0] * m[4] - m[1] * m[3];
+    mx = 0;
+    for (i = 0; i < 9; i++) {
+        if (c[i] > mx) { mx = c[i]; }
+        if (-c[i] > mx) { mx = -c[i]; }
+    }
+    sc = 0;
+    while ((mx >> sc) >= 020000) {
+        sc++;
+    }
+    for (i = 0; i < 9; i++) {
+        c[i] =>> sc;
+    }
+    /* the scale of c cancels out, m^-1 = c * 2^PP / det */
+    det = m[0] * c[0] + m[1] * c[1] + m[2] * c[2];
+    if (det == 0) { return(0); }
+    
+    for (j = 0; j < 3; j++) {
+        num = -(t[0] * c[j * 3 + 0] + t[1] * c[j * 3 + 1] + t[2] * c[j * 3 + 2]);
+        if ((det >= 0100000000) || (det <= -0100000000)) {
+            e[j] = num / (det >> PP);
+        } else {
+            q = num / det;
+            if ((q >= 010000) || (q <= -010000)) { return(0); }
+            e[j] = (q << PP) + (((num - q * det) << PP) / det);
+        }
+        if ((e[j] >= 02000000) || (e[j] <= -02000000)) { return(0); }
+    }
+    return((det > 0) ? 1 : -1);
+}
+
+/* the spectral norm of the model+view matrix is at most the square root
+ * of the largest row sum of m * m^T, adding 1/16th covers rounding */
+int
+mscl()
+{
+    register i, j, s;
+    int g, mx;
+    
+    if (xfdirt) {
+        xfload();
+    }
+    mx = 0;
+    for (i = 0; i < 9; i =+ 3) {
+        s = 0;
+        for (j = 0; j < 9; j =+ 3) {
+            g = mvw[i + 0] * mvw[j + 0]
+              + mvw[i + 1] * mvw[j + 1]
+              + mvw[i + 2] * mvw[j + 2];
+            s =+ (g < 0 ? -g : g);
+        }
+        if (s > mx) { mx = s; }
+    }
+    s = isqrt(mx);
+    return(s + (s >> 4) + 1);
+}
+
+int
+isqrt(n)
+register int n;
+{
+    register int r, b, t;
+    
+    r = 0;
+    b = 010000000000;
+    while (b > n) {
+        b =>> 2;
+    }
+    while (b) {
+        t = r + b;
+        if (n >= t) {
+            n =- t;
+            r = (r >> 1) + b;
+        } else {
+            r =>> 1;
+        }
+        b =>> 2;
     }
+    return(r);
+}
+
+/* distance between two points, rounded up */
+int
+vdist(a, b)
+register int *a, *b;
+{
+    register k, sh;
+    int d[3], s;
+
+    sh = 0;
+    for (k = 0; k < 3; k++) {
+        d[k] = a[k] - b[k];
+        if (d[k] < 0) { d[k] = -d[k]; }
+        while ((d[k] >> sh) >= 040000) {
+            sh++;
+        }
+    }
+    s = 0;
+    for (k = 0; k < 3; k++) {
+        s =+ (d[k] >> sh) * (d[k] >> sh);
+    }
+    return((isqrt(s) + 2) << sh);
 }
 
 mmul(a, b)
@@ -312,19 +611,40 @@ register int *v;
     }
 }
 
+psvtx(s, d, n, fov)
+register int *s, *d;
+register int n, fov;
+{
+    register int f;
+    int fsh, shift;
+    
+    fsh = 18 - fov; /* 2^(fov + 12) / z */
+    shift = fov - 2;
+    while (n--) {
+        if (!(s[3] & POCN)) {
+            f = recip(s[2]) >> fsh;
+            d[0] = ((s[0] * f + (1 << 11)) >> 12) + vpcenx;
+            d[1] = vpceny - ((s[1] * f + (1 << 11)) >> 12);
+            d[2] = f >> shift;
+        }
+        s =+ PVLEN;
+        d =+ PVLEN;
+    }
+}
+
 psproj(s, d, len, n, fov)
 register int *s, *d;
 register int len, n, fov;
 {
-    int ffac, nb, shift;
+    int fsh, nb, shift;
     
-    ffac = (1 << (fov + 12));
+    fsh = 18 - fov; /* 2^(fov + 12) / z */
     shift = fov - 2; /* to fit into short */
     
     len =- 3;
     nb = len * sizeof(int);
     while (n--) {
-        fov = ffac / s[2];
+        fov = recip(s[2]) >> fsh;
         /* rounding is necessary */
         *d++ = ((s[0] * fov + (1 << 11)) >> 12) + vpcenx;
         *d++ = vpceny - ((s[1] * fov + (1 << 11)) >> 12);
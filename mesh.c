@@ -0,0 +1,750 @@
+/*****************************************************************************/
+/*
+ * Early C implementation of an extra lite version of the PiSHi engine.
+ * 
+ *   by EMMIR 2018-2022
+ *   
+ *   YouTube: https://www.youtube.com/c/LMP88
+ *   
+ * This software is released into the public domain.
+ */
+/*****************************************************************************/
+
+#include "pl.h"
+
+/*  mesh.c
+ * 
+ * Mesh importer. Wavefront OBJ or ASCII PLY text is read a block at a
+ * time through a function supplied by the program so the file is never
+ * in memory as a whole. Coordinates are converted to integers without
+ * floating point and faces with more than four vertices are split into
+ * triangles. Faces are collected in batches of MBATCH polygons in which
+ * vertices that end up at the same position are welded. A mesh of more
+ * than one batch is built in the compact form one batch at a time, so
+ * apart from the result only one batch and the [x, y, z] shorts of the
+ * vertices of the file are in memory.
+ * 
+ */
+
+#define MBLK    512  /* bytes read at once */
+#define MLINE   256  /* the rest of a longer line is ignored */
+#define MFACE   64   /* max vertices in a face of the file */
+#define MFRAC   8    /* max fraction digits used */
+#define MELEM   8    /* max elements in a PLY file */
+#define MBATCH  1024 /* polygons in a batch */
+
+/* coordinates are kept as shorts, as in the compact form */
+#define MSHRT(x)  (((x) >= -0100000) && ((x) < 0100000))
+
+static int (*rdfn)(); /* read function of the program */
+static char blk[MBLK];
+static char *bp, *be; /* next unread byte and end of the block */
+static eof;
+static char line[MLINE];
+static char *lp; /* parse position in line */
+
+static struct PL_OBJ *dst;
+static struct PL_OBJ bat; /* batch of polygons being read */
+static vcap, pcap;        /* entries allocated for bat.c and bat.p */
+static struct PL_VH vh;   /* welds the vertices of the batch */
+static nbat;              /* batches appended to dst */
+static short *fv;         /* vertices of the file, [x, y, z] */
+static nin, fcap;
+static short *tc;         /* texture coords of the file, [U, V] */
+static ntc, tcap;
+/* entries allocated for the compact arrays of dst, entries in its pool */
+static cvcap, cpcap, cocap, ckcap, txcap, npool;
+static msc;               /* units per 1.0 in the file */
+static mcol;
+static struct PL_TEX *mtex;
+
+/* read next line into line[], returns 0 at the end of the input */
+static int
+getln()
+{
+    register char *d;
+    register c;
+    int n;
+    
+    d = line;
+    for (;;) {
+        if (bp >= be) {
+            if (eof) break;
+            n = (*rdfn)(blk, MBLK);
+            if (n <= 0) {
+                eof = 1;
+                break;
+            }
+            bp = blk;
+            be = blk + n;
+        }
+        c = *bp++;
+        if (c == '\n') break;
+        if ((c != '\r') && (d < (line + MLINE - 1))) {
+            *d++ = c;
+        }
+    }
+    *d = 0;
+    lp = line;
+    return(!eof || (d > line));
+}
+
+static
+skipws()
+{
+    while ((*lp == ' ') || (*lp == '\t')) {
+        lp++;
+    }
+}
+
+/* skip the next word if it is s */
+static int
+word(s)
+register char *s;
+{
+    register char *p;
+    
+    skipws();
+    for (p = lp; *s && (*p == *s); p++, s++);
+    if (*s || ((*p != 0) && (*p != ' ') && (*p != '\t'))) {
+        return(0);
+    }
+    lp = p;
+    return(1);
+}
+
+static int
+getint(v)
+int *v;
+{
+    register n, neg;
+    
+    skipws();
+    neg = (*lp == '-');
+    if (neg || (*lp == '+')) {
+        lp++;
+    }
+    if ((*lp < '0') || (*lp > '9')) return(0);
+    /* saturates rather than wrapping */
+    n = 0;
+    while ((*lp >= '0') && (*lp <= '9')) {
+        if (n < 0x0ccccccc) {
+            n = n * 10 + (*lp - '0');
+        }
+        lp++;
+    }
+    *v = neg ? -n : n;
+    return(1);
+}
+
+/* decimal number times sc, rounded. a result too large for a short
+ * is only known to be at least 0x0ccccccc */
+static int
+getnum(v, sc)
+int *v;
+{
+    register i, r;
+    int neg, ok, ip, nf, e, x;
+    char fd[MFRAC];
+    
+    skipws();
+    neg = (*lp == '-');
+    if (neg || (*lp == '+')) {
+        lp++;
+    }
+    if (sc < 0) {
+        neg = !neg;
+        sc = -sc;
+    }
+    ok = 0;
+    ip = 0;
+    x = 0; /* integer digits dropped, they only count in the exponent */
+    while ((*lp >= '0') && (*lp <= '9')) {
+        if (ip < 0x0ccccccc) {
+            ip = ip * 10 + (*lp - '0');
+        } else {
+            x++;
+        }
+        lp++;
+        ok = 1;
+    }
+    nf = 0;
+    if (*lp == '.') {
+        lp++;
+        while ((*lp >= '0') && (*lp <= '9')) {
+            if (nf < MFRAC) {
+                fd[nf++] = *lp - '0';
+            }
+            lp++;
+            ok = 1;
+        }
+    }
+    if (!ok) return(0);
+    /* keep ip * sc from overflowing, the fraction is below what is
+     * left of the precision then */
+    while (sc && (ip > (0x7fffffff - sc) / sc)) {
+        ip =/ 10;
+        x++;
+    }
+    if (x > 0) {
+        nf = 0;
+    }
+    /* fraction from the last digit to the first, in 1/16ths */
+    r = 0;
+    for (i = nf - 1; i >= 0; i--) {
+        r = (r + fd[i] * (sc << 4)) / 10;
+    }
+    r = ip * sc + ((r + 8) >> 4);
+    e = 0;
+    if ((*lp == 'e') || (*lp == 'E')) {
+        lp++;
+        if (!getint(&e)) return(0);
+    }
+    if (e < 0x40000000) {
+        e =+ x;
+    }
+    /* both loops end within ten steps, an exponent of any size is fine */
+    for (; (e > 0) && r && (r < 0x0ccccccc); e--) {
+        r =* 10;
+    }
+    for (; (e < 0) && r; e++) {
+        r = (r + 5) / 10;
+    }
+    *v = neg ? -r : r;
+    return(1);
+}
+
+/* add vertex of the file, with the engine's z */
+static int
+addfv(x, y, z)
+{
+    extern int agrow();
+    extern uerror();
+    
+    if (!MSHRT(x) || !MSHRT(y) || !MSHRT(z)) {
+        uerror(PERR_MISC, "mesh", "coordinates out of range");
+        return(0);
+    }
+    if (!agrow(&fv, &fcap, (nin + 1) * 3, sizeof(short))) return(0);
+    fv[nin * 3] = x;
+    fv[nin * 3 + 1] = y;
+    fv[nin * 3 + 2] = z;
+    nin++;
+    return(1);
+}
+
+static int
+addtc(u, v)
+{
+    extern int agrow();
+    extern uerror();
+    
+    if (!MSHRT(u) || !MSHRT(v)) {
+        uerror(PERR_MISC, "mesh", "texture coords out of range");
+        return(0);
+    }
+    if (!agrow(&tc, &tcap, (ntc + 1) * 2, sizeof(short))) return(0);
+    tc[ntc * 2] = u;
+    tc[ntc * 2 + 1] = v;
+    ntc++;
+    return(1);
+}
+
+/* vertex of the batch for vertex f of the file, -1 if out of memory */
+static int
+bvtx(f)
+{
+    extern int agrow(), vhget();
+    register i;
+    register int *c;
+    register short *v;
+    
+    v = fv + f * 3;
+    if (!agrow(&bat.c, &vcap, (bat.nc + 1) * PVLEN, sizeof(int))) {
+        return(-1);
+    }
+    i = vhget(&vh, bat.c, bat.nc, v[0], v[1], v[2]);
+    if (i == bat.nc) {
+        c = bat.c + i * PVLEN;
+        c[0] = v[0];
+        c[1] = v[1];
+        c[2] = v[2];
+        c[3] = 0;
+        bat.nc++;
+    }
+    return(i);
+}
+
+/* add polygon of the n vertices of the batch and [U, V] pairs */
+static int
+addp(ix, uv, n)
+int *ix, *uv;
+{
+    extern int agrow();
+    extern bufset();
+    register struct PL_POLY *p;
+    register i, b;
+    
+    if (!agrow(&bat.p, &pcap, bat.np + 1, sizeof(struct PL_POLY))) {
+        return(0);
+    }
+    p = &bat.p[bat.np++];
+    bufset(p, 0, sizeof(struct PL_POLY));
+    p->tex = mtex;
+    p->color = mcol;
+    p->nv = n;
+    for (i = 0; i <= n; i++) {
+        b = (i < n) ? i : 0;
+        p->v[i * PPOLY_VLEN    ] = ix[b];
+        p->v[i * PPOLY_VLEN + 1] = uv[b * 2];
+        p->v[i * PPOLY_VLEN + 2] = uv[b * 2 + 1];
+    }
+    return(1);
+}
+
+/* append the compact object s to dst */
+static int
+append(s)
+register struct PL_OBJ *s;
+{
+    extern int agrow();
+    extern bufcpy();
+    register struct PL_CPLY *q;
+    register i, j;
+    struct PL_CHK whole, *k;
+    struct PL_TEX *t;
+    int n, nk;
+    
+    n = 0;
+    for (i = 0; i < s->np; i++) {
+        n =+ s->cply[i].cpnv * PPOLY_VLEN;
+    }
+    /* an object without chunks is drawn as one */
+    k = s->ck;
+    nk = s->nck;
+    if (k == NULL) {
+        whole.ckv  = 0;
+        whole.cknv = s->nc;
+        whole.ckp  = 0;
+        whole.cknp = s->np;
+        for (i = 0; i < 3; i++) {
+            whole.ckcen[i] = s->bcen[i];
+        }
+        whole.ckrad = s->brad;
+        k = &whole;
+        nk = 1;
+    }
+    if (!agrow(&dst->cvtx, &cvcap, (dst->nc + s->nc) * 3, sizeof(short)) ||
+        !agrow(&dst->cply, &cpcap, dst->np + s->np, sizeof(struct PL_CPLY)) ||
+        !agrow(&dst->cpool, &cocap, npool + n, sizeof(char)) ||
+        !agrow(&dst->ck, &ckcap, dst->nck + nk, sizeof(struct PL_CHK)) ||
+        !agrow(&dst->txtab, &txcap, dst->ntx + s->ntx,
+               sizeof(struct PL_TEX *))) {
+        return(0);
+    }
+    bufcpy(dst->cvtx + dst->nc * 3, s->cvtx, s->nc * 3 * sizeof(short));
+    bufcpy(dst->cpool + npool, s->cpool, n);
+    for (i = 0; i < nk; i++, dst->nck++) {
+        bufcpy(&dst->ck[dst->nck], &k[i], sizeof(struct PL_CHK));
+        dst->ck[dst->nck].ckv =+ dst->nc;
+        dst->ck[dst->nck].ckp =+ dst->np;
+    }
+    for (i = 0; i < s->np; i++) {
+        q = &dst->cply[dst->np++];
+        bufcpy(q, &s->cply[i], sizeof(struct PL_CPLY));
+        q->cpix =+ npool / PPOLY_VLEN;
+        if (q->cptx) {
+            t = s->txtab[q->cptx - 1];
+            for (j = 0; (j < dst->ntx) && (dst->txtab[j] != t); j++);
+            if (j == dst->ntx) {
+                dst->txtab[dst->ntx++] = t;
+            }
+            q->cptx = j + 1;
+        }
+    }
+    dst->nc =+ s->nc;
+    npool =+ n;
+    return(1);
+}
+
+/* prepare the batch, append it to dst in the compact form and start
+ * the next one */
+static int
+flush()
+{
+    extern oprep(), odel(), vhclr(), uerror();
+    extern int ocmpk();
+    int ok;
+    
+    oprep(&bat);
+    if (!ocmpk(&bat)) {
+        uerror(PERR_MISC, "mesh", "batch can't be made compact");
+        return(0);
+    }
+    ok = append(&bat);
+    odel(&bat);
+    vcap = pcap = 0;
+    vhclr(&vh);
+    nbat++;
+    return(ok);
+}
+
+/* bounds of dst from its chunks and its arrays trimmed to their size */
+static int
+finish()
+{
+    extern int vdist(), asize();
+    register struct PL_CHK *k, *end;
+    register i;
+    int mn[3], mx[3], d;
+    
+    end = dst->ck + dst->nck;
+    for (i = 0; i < 3; i++) {
+        mn[i] =  077777777;
+        mx[i] = -077777777;
+        for (k = dst->ck; k < end; k++) {
+            if ((k->ckcen[i] - k->ckrad) < mn[i]) {
+                mn[i] = k->ckcen[i] - k->ckrad;
+            }
+            if ((k->ckcen[i] + k->ckrad) > mx[i]) {
+                mx[i] = k->ckcen[i] + k->ckrad;
+            }
+        }
+        dst->bcen[i] = (mn[i] + mx[i]) >> 1;
+    }
+    dst->brad = 1;
+    for (k = dst->ck; k < end; k++) {
+        d = vdist(dst->bcen, k->ckcen) + k->ckrad;
+        if (d > dst->brad) {
+            dst->brad = d;
+        }
+    }
+    return(asize(&dst->cvtx, &cvcap, dst->nc * 3, sizeof(short)) &&
+           asize(&dst->cply, &cpcap, dst->np, sizeof(struct PL_CPLY)) &&
+           asize(&dst->cpool, &cocap, npool, sizeof(char)) &&
+           asize(&dst->ck, &ckcap, dst->nck, sizeof(struct PL_CHK)) &&
+           asize(&dst->txtab, &txcap, dst->ntx, sizeof(struct PL_TEX *)));
+}
+
+/* move the texture coords of a face by whole periods of the texture,
+ * which the rasterizer wraps anyway, so they fit in a char as in the
+ * compact form. the same is done for every mesh so a mesh loads the
+ * same no matter how many batches it has. returns 0 if they are too
+ * far apart to fit */
+static int
+wrap(uv, n)
+register int *uv;
+{
+    register i, lo, hi;
+    int k, s;
+    
+    for (k = 0; k < 2; k++) {
+        lo = hi = uv[k];
+        for (i = 1; i < n; i++) {
+            if (uv[i * 2 + k] < lo) { lo = uv[i * 2 + k]; }
+            if (uv[i * 2 + k] > hi) { hi = uv[i * 2 + k]; }
+        }
+        if ((lo >= -0200) && (hi < 0200)) {
+            continue;
+        }
+        /* the largest shift leaving lo at or above -0200 */
+        s = (lo + 0200) & ~(PTDIM - 1);
+        if ((hi - s) >= 0200) {
+            return(0);
+        }
+        for (i = 0; i < n; i++) {
+            uv[i * 2 + k] =- s;
+        }
+    }
+    return(1);
+}
+
+/* add face from indices of vertices and texture coords in the file,
+ * tf[i] is -1 for a vertex without texture coords.
+ * the file is right handed with counterclockwise front faces */
+static int
+face(vf, tf, n)
+int *vf, *tf;
+{
+    extern uerror();
+    register i, j, k;
+    int b, ix[MFACE], uv[MFACE * 2], t[3], tuv[6];
+    
+    for (i = 0; i < n; i++) {
+        if ((vf[i] < 0) || (vf[i] >= nin) ||
+            (tf[i] < -1) || (tf[i] >= ntc)) {
+            uerror(PERR_MISC, "mesh", "bad index");
+            return(0);
+        }
+    }
+    /* a face is never split between batches */
+    if ((bat.np >= MBATCH) && !flush()) return(0);
+    j = 0;
+    for (i = n - 1; i >= 0; i--) {
+        if ((k = bvtx(vf[i])) < 0) return(0);
+        /* welding can leave the same vertex twice in a row */
+        if ((j > 0) && (ix[j - 1] == k)) continue;
+        ix[j] = k;
+        uv[j * 2] = (tf[i] < 0) ? 0 : tc[tf[i] * 2];
+        uv[j * 2 + 1] = (tf[i] < 0) ? 0 : tc[tf[i] * 2 + 1];
+        j++;
+    }
+    if ((j > 1) && (ix[j - 1] == ix[0])) {
+        j--;
+    }
+    if (j < 3) return(1);
+    if (!wrap(uv, j)) {
+        uerror(PERR_MISC, "mesh", "texture coords of a face too far apart");
+        return(0);
+    }
+    if (j <= 4) {
+        return(addp(ix, uv, j));
+    }
+    for (i = 1; i < (j - 1); i++) {
+        for (k = 0; k < 3; k++) {
+            b = (k == 0) ? 0 : (i + k - 1);
+            t[k] = ix[b];
+            tuv[k * 2] = uv[b * 2];
+            tuv[k * 2 + 1] = uv[b * 2 + 1];
+        }
+        if (!addp(t, tuv, 3)) return(0);
+    }
+    return(1);
+}
+
+/* texture coords of the file to texel units, V goes up in the file */
+static int
+addvt()
+{
+    extern uerror();
+    int u, v;
+    
+    if (!getnum(&u, PTDIM - 1) || !getnum(&v, PTDIM - 1)) {
+        uerror(PERR_MISC, "mesh", "bad texture coords");
+        return(0);
+    }
+    return(addtc(u, (PTDIM - 1) - v));
+}
+
+/* vertex in the file to the left handed space of the engine */
+static int
+rdvtx(x, y, z)
+{
+    return(addfv(x, y, -z));
+}
+
+static int
+objrd()
+{
+    extern uerror();
+    int n, x, y, z, vf[MFACE + 1], tf[MFACE + 1];
+    
+    do {
+        if (word("v")) {
+            if (!getnum(&x, msc) || !getnum(&y, msc) || !getnum(&z, msc)) {
+                uerror(PERR_MISC, "mesh", "bad vertex");
+                return(0);
+            }
+            if (!rdvtx(x, y, z)) return(0);
+        } else if (word("vt")) {
+            if (!addvt()) return(0);
+        } else if (word("f")) {
+            /* v, v/vt, v//vn or v/vt/vn, counting from 1 or from the end */
+            for (n = 0; getint(&vf[n]); n++) {
+                if (n >= MFACE) {
+                    uerror(PERR_MISC, "mesh", "face too big");
+                    return(0);
+                }
+                vf[n] = (vf[n] < 0) ? (nin + vf[n]) : (vf[n] - 1);
+                tf[n] = -1;
+                if (*lp == '/') {
+                    lp++;
+                    if ((*lp != '/') && getint(&tf[n])) {
+                        tf[n] = (tf[n] < 0) ? (ntc + tf[n]) : (tf[n] - 1);
+                    }
+                    if (*lp == '/') {
+                        lp++;
+                        getint(&x);
+                    }
+                }
+            }
+            if (!face(vf, tf, n)) return(0);
+        }
+        /* the rest is ignored */
+    } while (getln());
+    return(1);
+}
+
+/* PLY element kinds */
+#define EOTHER  0
+#define EVERT   1
+#define EFACE   2
+
+static int
+plyrd()
+{
+    extern uerror();
+    int ne, ek[MELEM], en[MELEM]; /* kind and count of each element */
+    int nvp, px, py, pz, pu, pv;  /* vertex properties */
+    int fp;                       /* face properties before the indices */
+    int fl;                       /* the list of indices was declared */
+    int e, i, j, k, n, v[MFACE + 8], tf[MFACE];
+    
+    ne = 0;
+    nvp = 0;
+    px = py = pz = pu = pv = -1;
+    fp = 0;
+    fl = 0;
+    if (!getln() || !word("format") || !word("ascii")) {
+        uerror(PERR_MISC, "mesh", "only ASCII PLY is read");
+        return(0);
+    }
+    while (getln() && !word("end_header")) {
+        if (word("element")) {
+            if (ne >= MELEM) {
+                uerror(PERR_MISC, "mesh", "too many elements");
+                return(0);
+            }
+            ek[ne] = word("vertex") ? EVERT : (word("face") ? EFACE : EOTHER);
+            if (!getint(&en[ne])) {
+                uerror(PERR_MISC, "mesh", "bad element");
+                return(0);
+            }
+            ne++;
+        } else if (word("property") && (ne > 0)) {
+            if (ek[ne - 1] == EVERT) {
+                if (word("list")) {
+                    uerror(PERR_MISC, "mesh", "list in vertex");
+                    return(0);
+                }
+                skipws();
+                while (*lp && (*lp != ' ') && (*lp != '\t')) {
+                    lp++;
+                }
+                if (word("x")) { px = nvp; }
+                else if (word("y")) { py = nvp; }
+                else if (word("z")) { pz = nvp; }
+                else if (word("s") || word("u") || word("texture_u")) {
+                    pu = nvp;
+                } else if (word("t") || word("v") || word("texture_v")) {
+                    pv = nvp;
+                }
+                nvp++;
+            } else if (ek[ne - 1] == EFACE) {
+                /* properties after the list are left on the line */
+                if (word("list")) {
+                    if (fl) {
+                        uerror(PERR_MISC, "mesh", "more than one list in face");
+                        return(0);
+                    }
+                    fl = 1;
+                } else if (!fl) {
+                    fp++;
+                }
+            }
+        }
+    }
+    if ((px < 0) || (py < 0) || (pz < 0) || (nvp > MFACE + 8)) {
+        uerror(PERR_MISC, "mesh", "bad vertex properties");
+        return(0);
+    }
+    for (e = 0; e < ne; e++) {
+        for (i = 0; i < en[e]; i++) {
+            if (!getln()) {
+                uerror(PERR_MISC, "mesh", "unexpected end of file");
+                return(0);
+            }
+            if (ek[e] == EVERT) {
+                for (j = 0; j < nvp; j++) {
+                    k = ((j == pu) || (j == pv)) ? (PTDIM - 1) : msc;
+                    if (!getnum(&v[j], k)) {
+                        uerror(PERR_MISC, "mesh", "bad vertex");
+                        return(0);
+                    }
+                }
+                if (!rdvtx(v[px], v[py], v[pz])) return(0);
+                if ((pu >= 0) && (pv >= 0)) {
+                    if (!addtc(v[pu], (PTDIM - 1) - v[pv])) return(0);
+                }
+            } else if (ek[e] == EFACE) {
+                for (j = 0; j < fp; j++) {
+                    getnum(&k, 1);
+                }
+                if (!getint(&n) || (n > MFACE)) {
+                    uerror(PERR_MISC, "mesh", "bad face");
+                    return(0);
+                }
+                for (j = 0; j < n; j++) {
+                    if (!getint(&v[j])) {
+                        uerror(PERR_MISC, "mesh", "bad face");
+                        return(0);
+                    }
+                    tf[j] = (ntc > 0) ? v[j] : -1;
+                }
+                if (!face(v, tf, n)) return(0);
+            }
+        }
+    }
+    return(1);
+}
+
+extern int
+oload(o, rd, sc, tex, color)
+struct PL_OBJ *o;
+int (*rd)();
+struct PL_TEX *tex;
+{
+    extern umemfr(), odel(), oprep(), bufset(), vhdel(), uerror();
+    extern int asize(), umemtg();
+    int ok, tag;
+    
+    odel(o);
+    tag = umemtg(PMMESH);
+    rdfn = rd;
+    bp = be = blk;
+    eof = 0;
+    dst = o;
+    bufset(&bat, 0, sizeof(struct PL_OBJ));
+    vcap = pcap = fcap = tcap = 0;
+    cvcap = cpcap = cocap = ckcap = txcap = npool = 0;
+    nin = ntc = nbat = 0;
+    fv = tc = NULL;
+    msc = sc;
+    mtex = tex;
+    mcol = color;
+    ok = getln();
+    if (ok) {
+        ok = word("ply") ? plyrd() : objrd();
+    }
+    if (ok && (nbat == 0) && (bat.np > 0)) {
+        /* a single batch becomes the object as it is */
+        ok = asize(&bat.c, &vcap, bat.nc * PVLEN, sizeof(int)) &&
+             asize(&bat.p, &pcap, bat.np, sizeof(struct PL_POLY));
+        if (ok) {
+            o->c  = bat.c;
+            o->nc = bat.nc;
+            o->p  = bat.p;
+            o->np = bat.np;
+            bat.c = NULL;
+            bat.p = NULL;
+            oprep(o);
+        }
+    } else if (ok && (nbat > 0)) {
+        ok = ((bat.np == 0) || flush()) && finish();
+    }
+    odel(&bat);
+    vhdel(&vh);
+    if (fv) { umemfr(fv); }
+    if (tc) { umemfr(tc); }
+    fv = tc = NULL;
+    umemtg(tag);
+    if (ok && (o->np == 0)) {
+        uerror(PERR_MISC, "mesh", "no faces");
+        ok = 0;
+    }
+    if (!ok) {
+        odel(o);
+        return(0);
+    }
+    return(1);
+}
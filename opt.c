@@ -0,0 +1,365 @@
+/*****************************************************************************/
+/*
+ * Early C implementation of an extra lite version of the PiSHi engine.
+ * 
+ *   by EMMIR 2018-2022
+ *   
+ *   YouTube: https://www.youtube.com/c/LMP88
+ *   
+ * This software is released into the public domain.
+ */
+/*****************************************************************************/
+
+#include "pl.h"
+
+/*  opt.c
+ * 
+ * Polygon and vertex order optimizer. Polygons are reordered so that
+ * the vertices they use were used by the polygons just before them,
+ * after the method of T. Forsyth, and grouped by texture. Vertices are
+ * then renumbered in the order they are first used so the transformed
+ * vertices are read front to back when the polygons are drawn.
+ * Chunks are optimized one by one and keep their vertices.
+ * 
+ */
+
+#define OCACHE  16 /* vertices in the simulated cache */
+
+static ocsc[OCACHE]; /* score of a vertex by its position in the cache */
+
+/* scores are in 1/1024ths */
+static int
+vscore(pos, live)
+{
+    extern int isqrt();
+    register s;
+    
+    if (live <= 0) return(-1);
+    s = (pos < 0) ? 0 : ocsc[pos];
+    /* fewer polygons left to use a vertex make it more urgent */
+    return(s + ((2048 << 4) / isqrt(live << 8)));
+}
+
+/* misses of a FIFO cache of OCACHE vertices over polygons pl to pl + n */
+static int
+misses(pl, n, stamp)
+struct PL_POLY *pl;
+int *stamp;
+{
+    register struct PL_POLY *p;
+    register j, v;
+    int fifo[OCACHE], h, miss;
+    
+    for (j = 0; j < OCACHE; j++) {
+        fifo[j] = -1;
+    }
+    h = 0;
+    miss = 0;
+    for (p = pl; p < pl + n; p++) {
+        for (j = 0; j < p->nv; j++) {
+            v = p->v[j * 3];
+            /* stamp holds the slot plus one of cached vertices */
+            if (stamp[v] && (fifo[stamp[v] - 1] == v)) continue;
+            miss++;
+            if (fifo[h] >= 0) {
+                stamp[fifo[h]] = 0;
+            }
+            fifo[h] = v;
+            stamp[v] = h + 1;
+            h = (h + 1) % OCACHE;
+        }
+    }
+    for (j = 0; j < OCACHE; j++) {
+        if (fifo[j] >= 0) {
+            stamp[fifo[j]] = 0;
+        }
+    }
+    return(miss);
+}
+
+extern int
+oacmr(o)
+register struct PL_OBJ *o;
+{
+    extern char *umemgt();
+    extern umemfr(), bufset(), uerror();
+    struct PL_CHK *k, *end, whole;
+    int *stamp, miss, tris, j;
+    
+    if ((o->c == NULL) || (o->np <= 0)) return(0);
+    stamp = umemgt(o->nc, sizeof(int));
+    if (stamp == NULL) {
+        uerror(PERR_NO_MEM, "opt", "no memory");
+        return(0);
+    }
+    bufset(stamp, 0, o->nc * sizeof(int));
+    whole.ckp  = 0;
+    whole.cknp = o->np;
+    k = &whole;
+    end = k + 1;
+    if (o->ck) {
+        k = o->ck;
+        end = k + o->nck;
+    }
+    /* chunks are transformed separately, so each starts out cold */
+    miss = 0;
+    for (; k < end; k++) {
+        miss =+ misses(o->p + k->ckp, k->cknp, stamp);
+    }
+    tris = 0;
+    for (j = 0; j < o->np; j++) {
+        tris =+ o->p[j].nv - 2;
+    }
+    umemfr(stamp);
+    return(tris ? ((miss << PP) / tris) : 0);
+}
+
+/* per vertex of the chunk being optimized */
+static int *live;  /* polygons left to draw that use it */
+static int *vsc;   /* score */
+static int *cpos;  /* position in the cache, -1 if not in it */
+static int *adj;   /* index into pidx of the first polygon using it */
+static int *nidx;  /* new index */
+static int *vtmp;  /* coords in the new order */
+/* per polygon of the chunk */
+static int *pidx;  /* polygons using each vertex, see adj */
+static int *tord;  /* polygons grouped by texture */
+static int *done;
+static int *ord;   /* new order */
+static struct PL_POLY *ptmp;
+static struct PL_TEX **ttab;
+
+static cache[OCACHE + PPMAXE];
+static ncache;
+
+/* move vertex to the front of the cache */
+static
+touch(v)
+register v;
+{
+    register i;
+    
+    i = (cpos[v] >= 0) ? cpos[v] : ncache++;
+    for (; i > 0; i--) {
+        cache[i] = cache[i - 1];
+        cpos[cache[i]] = i;
+    }
+    cache[0] = v;
+    cpos[v] = 0;
+}
+
+/* optimize polygons pl to pl + m which use vertices v0 to v0 + n */
+static
+ochk(o, pl, m, v0, n)
+struct PL_OBJ *o;
+struct PL_POLY *pl;
+{
+    extern bufcpy();
+    register struct PL_POLY *p;
+    register i, j;
+    int v, k, a, e, nt, best, bs, sc, scan;
+    struct PL_TEX *ctex;
+    
+    for (i = 0; i <= n; i++) {
+        adj[i] = 0;
+    }
+    for (p = pl; p < pl + m; p++) {
+        for (j = 0; j < p->nv; j++) {
+            adj[p->v[j * 3] - v0 + 1]++;
+        }
+    }
+    for (i = 0; i < n; i++) {
+        live[i] = adj[i + 1];
+        adj[i + 1] =+ adj[i];
+        cpos[i] = adj[i]; /* fill position */
+    }
+    for (i = 0; i < m; i++) {
+        p = &pl[i];
+        for (j = 0; j < p->nv; j++) {
+            pidx[cpos[p->v[j * 3] - v0]++] = i;
+        }
+        done[i] = 0;
+    }
+    for (i = 0; i < n; i++) {
+        cpos[i] = -1;
+        vsc[i] = vscore(-1, live[i]);
+    }
+    ncache = 0;
+    
+    /* stable grouping by texture, in order of first use */
+    nt = 0;
+    for (i = 0; i < m; i++) {
+        for (j = 0; (j < nt) && (ttab[j] != pl[i].tex); j++);
+        if (j == nt) {
+            ttab[nt++] = pl[i].tex;
+        }
+    }
+    e = 0;
+    for (j = 0; j < nt; j++) {
+        for (i = 0; i < m; i++) {
+            if (pl[i].tex == ttab[j]) {
+                tord[e++] = i;
+            }
+        }
+    }
+    
+    scan = 0;
+    ctex = NULL;
+    for (e = 0; e < m; e++) {
+        /* best polygon using a cached vertex */
+        best = -1;
+        bs = -1;
+        for (k = 0; k < ncache; k++) {
+            v = cache[k];
+            for (a = adj[v]; a < adj[v + 1]; a++) {
+                i = pidx[a];
+                if (done[i] || (pl[i].tex != ctex)) continue;
+                sc = 0;
+                for (j = 0; j < pl[i].nv; j++) {
+                    sc =+ vsc[pl[i].v[j * 3] - v0];
+                }
+                if (sc > bs) {
+                    bs = sc;
+                    best = i;
+                }
+            }
+        }
+        /* else the first one left, which starts a new texture group
+         * once the current one is used up */
+        if (best < 0) {
+            while (done[tord[scan]]) {
+                scan++;
+            }
+            best = tord[scan];
+            ctex = pl[best].tex;
+        }
+        done[best] = 1;
+        ord[e] = best;
+        p = &pl[best];
+        for (j = 0; j < p->nv; j++) {
+            v = p->v[j * 3] - v0;
+            live[v]--;
+            touch(v);
+        }
+        for (k = OCACHE; k < ncache; k++) {
+            cpos[cache[k]] = -1;
+            vsc[cache[k]] = vscore(-1, live[cache[k]]);
+        }
+        if (ncache > OCACHE) {
+            ncache = OCACHE;
+        }
+        for (k = 0; k < ncache; k++) {
+            vsc[cache[k]] = vscore(k, live[cache[k]]);
+        }
+    }
+    
+    /* vertices in order of first use, unused ones last */
+    for (i = 0; i < n; i++) {
+        nidx[i] = -1;
+    }
+    k = 0;
+    for (e = 0; e < m; e++) {
+        p = &pl[ord[e]];
+        for (j = 0; j < p->nv; j++) {
+            v = p->v[j * 3] - v0;
+            if (nidx[v] < 0) {
+                nidx[v] = k++;
+            }
+        }
+    }
+    for (i = 0; i < n; i++) {
+        if (nidx[i] < 0) {
+            nidx[i] = k++;
+        }
+        bufcpy(vtmp + nidx[i] * PVLEN, o->c + (v0 + i) * PVLEN,
+               PVLEN * sizeof(int));
+    }
+    bufcpy(o->c + v0 * PVLEN, vtmp, n * PVLEN * sizeof(int));
+    for (e = 0; e < m; e++) {
+        bufcpy(&ptmp[e], &pl[ord[e]], sizeof(struct PL_POLY));
+        p = &ptmp[e];
+        /* including the copy of the first vertex at the end */
+        for (j = 0; j <= p->nv; j++) {
+            p->v[j * 3] = v0 + nidx[p->v[j * 3] - v0];
+        }
+    }
+    bufcpy(pl, ptmp, m * sizeof(struct PL_POLY));
+}
+
+extern int
+oopt(o)
+register struct PL_OBJ *o;
+{
+    extern char *umemgt();
+    extern umemfr(), uerror(), oprep();
+    extern int isqrt();
+    register struct PL_CHK *k;
+    struct PL_CHK *end, whole;
+    int i, x, n, m, a, ok;
+    
+    if (ocsc[0] == 0) {
+        /* the last three used score lower so strips aren't favored */
+        for (i = 0; i < OCACHE; i++) {
+            x = 1024 - ((i - 3) << 10) / (OCACHE - 3);
+            ocsc[i] = (i < 3) ? 768 : ((x * isqrt(x)) >> 5);
+        }
+    }
+    if (o->brad == 0) {
+        oprep(o);
+    }
+    if ((o->c == NULL) || (o->np <= 0)) return(0);
+    whole.ckv  = 0;
+    whole.cknv = o->nc;
+    whole.ckp  = 0;
+    whole.cknp = o->np;
+    k = &whole;
+    end = k + 1;
+    if (o->ck) {
+        k = o->ck;
+        end = k + o->nck;
+    }
+    n = 0;
+    m = 0;
+    a = 0;
+    for (; k < end; k++) {
+        if (k->cknv > n) { n = k->cknv; }
+        if (k->cknp > m) { m = k->cknp; }
+    }
+    for (i = 0; i < o->np; i++) {
+        a =+ o->p[i].nv;
+    }
+    live = umemgt(n, sizeof(int));
+    vsc  = umemgt(n, sizeof(int));
+    cpos = umemgt(n, sizeof(int));
+    adj  = umemgt(n + 1, sizeof(int));
+    nidx = umemgt(n, sizeof(int));
+    vtmp = umemgt(n * PVLEN, sizeof(int));
+    pidx = umemgt(a, sizeof(int));
+    tord = umemgt(m, sizeof(int));
+    done = umemgt(m, sizeof(int));
+    ord  = umemgt(m, sizeof(int));
+    ptmp = umemgt(m, sizeof(struct PL_POLY));
+    ttab = umemgt(m, sizeof(struct PL_TEX *));
+    ok = live && vsc && cpos && adj && nidx && vtmp &&
+         pidx && tord && done && ord && ptmp && ttab;
+    if (ok) {
+        for (k = (o->ck ? o->ck : &whole); k < end; k++) {
+            ochk(o, o->p + k->ckp, k->cknp, k->ckv, k->cknv);
+        }
+    } else {
+        uerror(PERR_NO_MEM, "opt", "no memory");
+    }
+    if (live) { umemfr(live); }
+    if (vsc)  { umemfr(vsc); }
+    if (cpos) { umemfr(cpos); }
+    if (adj)  { umemfr(adj); }
+    if (nidx) { umemfr(nidx); }
+    if (vtmp) { umemfr(vtmp); }
+    if (pidx) { umemfr(pidx); }
+    if (tord) { umemfr(tord); }
+    if (done) { umemfr(done); }
+    if (ord)  { umemfr(ord); }
+    if (ptmp) { umemfr(ptmp); }
+    if (ttab) { umemfr(ttab); }
+    return(ok);
+}
@@ -22,28 +22,28 @@ vfov  9;
 rastm PRFLAT;
 cullm PCBACK;
 
-/* temp vertices */
-static tv[POMAXV];
+/* temp vertices, followed by the PRING kept by pvtx() */
+static tv[(POMAXV + PRING) * PVLEN];
+/* temp vertices projected to the screen, only valid for the ones
+ * in front of the near plane */
+static sv[(POMAXV + PRING) * PVLEN];
+/* object index of the first vertex in tv and sv */
+static vbase 0;
 
+/* load polygon from the view space (tv) or screen space (sv) vertices */
 static
-loadvs(d, s, dim, len, minz, maxz)
+loadvs(d, s, dim, len, src)
 register int *d, *s;
-int *minz, *maxz;
+int *src;
 {
-    int z, mn, mx, i;
-    
-    mn =  0x7ffffff;
-    mx = -0x7ffffff;
+    int i;
     
     while (len--) {
         /* index into object vertex array */
-        i = s[0] * PVLEN;
-        d[0] = tv[i + 0];
-        d[1] = tv[i + 1];
-        d[2] = tv[i + 2];
-        z = d[2];
-        if (z > mx) { mx = z; }
-        if (z < mn) { mn = z; }
+        i = (s[0] - vbase) * PVLEN;
+        d[0] = src[i + 0];
+        d[1] = src[i + 1];
+        d[2] = src[i + 2];
 
         if (dim == PSTEX) {
             d[3] = s[1] << PTLOG;
@@ -52,70 +52,360 @@ int *minz, *maxz;
         s =+ 3;
         d =+ dim;
     }
-    *minz = mn;
-    *maxz = mx;
 }
 
+/* draw polygon already projected to the screen */
 static
-rpoly(poly)
-struct PL_POLY *poly;
+pspoly(proj, stype, nedge, oc, tex, color)
+int *proj;
+struct PL_TEX *tex;
+{
+    register int res;
+    
+    /* most polygons need no 2D clipping at all */
+    res = PCVI;
+    if (oc & POCS) {
+        res = ctestv(proj, stype, nedge);
+        if (res == PCVO) { return; }
+    }
+    pscanm = res;
+    
+    if (stype == PSFLAT) {
+        pfpoly(proj, nedge, color);
+    } else if (tex->txflg & PTFKEY) {
+        pkpoly(proj, nedge, tex->texdat);
+    } else {
+        ptpoly(proj, nedge, tex->texdat);
+    }
+}
+
+pvpoly(v, stype, nedge, oc, tex, color)
+int *v;
+struct PL_TEX *tex;
 {
-    int copy[PPMAXV * PVDIM];
     int clip[PPMAXV * PVDIM];
     int proj[PPMAXV * PVDIM];
-    int minz, maxz; /* z extents for frustum testing */
-    register int res; /* result of frustum test */
-    register int stype = PSFLAT; /* stream type */
-    register int nedge;
-    int *in;
     
-    nedge = poly->nv;
-    in = copy;
+    if (oc & POCZ) {
+        nedge = cpolyz(clip, v, stype, nedge);
+        v = clip;
+    }
     
-    if ((rastm == PRTEX) && (poly->tex && poly->tex->texdat)) {
-        stype = PSTEX;
+    psproj(v, proj, stype, nedge + 1, vfov);
+    pspoly(proj, stype, nedge, oc, tex, color);
+}
+
+/* test if a polygon is culled given the signed distance of the eye
+ * in object space from its plane and the sign of the model+view
+ * determinant, a mirroring transform flips the side the polygon faces */
+static int
+pside(d, s)
+register int d;
+{
+    return((((s > 0) ? (d < 0) : (d > 0)) + 1) & cullm);
+}
+
+static int
+pcull(p, e, s)
+register struct PL_POLY *p;
+register int *e;
+{
+    return(pside(p->pnrm[0] * e[0] + p->pnrm[1] * e[1] + p->pnrm[2] * e[2]
+                 - p->pdst, s));
+}
+
+static int
+cpcull(q, e, s)
+register struct PL_CPLY *q;
+register int *e;
+{
+    return(pside(q->cpnrm[0] * e[0] + q->cpnrm[1] * e[1] + q->cpnrm[2] * e[2]
+                 - q->cpdst, s));
+}
+
+/* draw polygon given its [index, U, V] list */
+static
+rpoly(v, nedge, tex, color, cull)
+register int *v;
+register int nedge;
+struct PL_TEX *tex;
+{
+    int copy[PPMAXV * PVDIM];
+    int ocand, ocor; /* combined outcodes for frustum testing */
+    register int stype = PSFLAT; /* stream type */
+    register int i;
+    int *a, *b, *c;
+    
+    ocand = ~0;
+    ocor = 0;
+    for (i = 0; i < nedge; i++) {
+        ocand =& tv[(v[i * 3] - vbase) * PVLEN + 3];
+        ocor  =| tv[(v[i * 3] - vbase) * PVLEN + 3];
     }
-   
-    loadvs(copy, poly->v, stype, nedge + 1, &minz, &maxz);
-    res = ctestz(minz, maxz);
-    if (res == PCCB) { return; }
+    /* completely outside of one of the frustum planes */
+    if (ocand & POCX) { return; }
 
     /* test winding order in view space rather than screen space */    
-    if ((porder(copy, copy + stype, copy + stype * 2) + 1) & cullm) {
-        return;
+    if (cull) {
+        a = tv + (v[0] - vbase) * PVLEN;
+        b = tv + (v[3] - vbase) * PVLEN;
+        c = tv + (v[6] - vbase) * PVLEN;
+        if ((porder(a, b, c) + 1) & cullm) {
+            return;
+        }
     }
     
-    if (res == PCCX) {
-        in = clip;
-        nedge = cpolyz(in, copy, stype, nedge);
+    /* only polygons that are drawn bring their texture in */
+    if ((rastm == PRTEX) && tex && tcuse(tex)) {
+        stype = PSTEX;
     }
+    if (ocor & POCZ) {
+        /* clipping makes new vertices, project the polygon as a whole */
+        loadvs(copy, v, stype, nedge + 1, tv);
+        pvpoly(copy, stype, nedge, ocor, tex, color);
+    } else {
+        loadvs(copy, v, stype, nedge + 1, sv);
+        pspoly(copy, stype, nedge, ocor, tex, color);
+    }
+}
+
+/* pick the level of detail by how far away the object is */
+static struct PL_OBJ *
+olsel(o)
+register struct PL_OBJ *o;
+{
+    extern xfvecs();
+    int c[PVLEN];
     
-    psproj(in, proj, stype, nedge + 1, vfov);
-    
-    if (stype == PSTEX) {
-        ptpoly(proj, nedge, poly->tex->texdat);
+    if (o->lnext) {
+        xfvecs(o->bcen, c, 1);
+        while (o->lnext && (c[2] >= o->ldist)) {
+            o = o->lnext;
+        }
+    }
+    return(o);
+}
+
+/* orng() for the compact form, the indices are relative to the chunk */
+static
+ocrng(o, k, e, s, res)
+struct PL_OBJ *o;
+register struct PL_CHK *k;
+int *e;
+{
+    extern xfsvec(), psvtx();
+    register struct PL_CPLY *q, *end;
+    register char *x;
+    register i;
+    struct PL_TEX *t;
+    int v[(PPMAXE + 1) * PPOLY_VLEN];
+
+    vbase = 0;
+    q = &o->cply[k->ckp];
+    end = q + k->cknp;
+    if (s) {
+        for (i = 3; i < k->cknv * PVLEN; i =+ PVLEN) {
+            tv[i] = POCU;
+        }
+        for (; q < end; q++) {
+            if (cpcull(q, e, s)) { continue; }
+            x = o->cpool + q->cpix * PPOLY_VLEN;
+            for (i = 0; i < q->cpnv; i++) {
+                tv[x[i * PPOLY_VLEN] * PVLEN + 3] = 0;
+            }
+        }
+        q = &o->cply[k->ckp];
     } else {
-        pfpoly(proj, nedge, poly->color);
+        for (i = 3; i < k->cknv * PVLEN; i =+ PVLEN) {
+            tv[i] = 0;
+        }
+    }
+    xfsvec(o->cvtx + k->ckv * 3, tv, k->cknv, res != PCCI);
+    psvtx(tv, sv, k->cknv, vfov);
+    for (; q < end; q++) {
+        if (s && cpcull(q, e, s)) { continue; }
+        x = o->cpool + q->cpix * PPOLY_VLEN;
+        for (i = 0; i < q->cpnv * PPOLY_VLEN; i++) {
+            v[i] = x[i];
+        }
+        v[i + 0] = x[0];
+        v[i + 1] = x[1];
+        v[i + 2] = x[2];
+        t = q->cptx ? o->txtab[q->cptx - 1] : NULL;
+        rpoly(v, q->cpnv, t, q->cpcol, !s);
+    }
+}
+
+/* draw the polygons of a chunk. e is the eye in object space and
+ * s the sign from xfeye(), res is the ctests() result of the chunk */
+static
+orng(o, k, e, s, res)
+struct PL_OBJ *o;
+register struct PL_CHK *k;
+int *e;
+{
+    extern xfcvec(), psvtx();
+    register struct PL_POLY *p, *end;
+    register i, j;
+
+    if (o->cvtx) {
+        ocrng(o, k, e, s, res);
+        return;
+    }
+    vbase = k->ckv;
+    p = &o->p[k->ckp];
+    end = p + k->cknp;
+    /* cull against the eye in object space before transforming so the
+     * vertices of polygons facing away are left alone. the planes are
+     * only there if oprep() ran */
+    if (s) {
+        for (i = 3; i < k->cknv * PVLEN; i =+ PVLEN) {
+            tv[i] = POCU;
+        }
+        for (; p < end; p++) {
+            if (pcull(p, e, s)) { continue; }
+            for (j = 0; j < p->nv; j++) {
+                tv[(p->v[j * 3] - vbase) * PVLEN + 3] = 0;
+            }
+        }
+        p = &o->p[k->ckp];
+    } else {
+        for (i = 3; i < k->cknv * PVLEN; i =+ PVLEN) {
+            tv[i] = 0;
+        }
+    }
+    /* nothing can need clipping when entirely inside the frustum */
+    xfcvec(o->c + vbase * PVLEN, tv, k->cknv, res != PCCI);
+    /* project each vertex once instead of once per polygon using it */
+    psvtx(tv, sv, k->cknv, vfov);
+    for (; p < end; p++) {
+        if (s) {
+            if (!pcull(p, e, s)) { rpoly(p->v, p->nv, p->tex, p->color, 0); }
+        } else {
+            rpoly(p->v, p->nv, p->tex, p->color, 1);
+        }
+    }
+}
+
+extern
+pvtx(i, x, y, z)
+{
+    extern xfcvec(), psvtx();
+    register int *t;
+    int v[PVLEN];
+    
+    v[0] = x;
+    v[1] = y;
+    v[2] = z;
+    v[3] = 0;
+    t = tv + (POMAXV + i) * PVLEN;
+    t[3] = 0;
+    xfcvec(v, t, 1, 1);
+    psvtx(t, sv + (POMAXV + i) * PVLEN, 1, vfov);
+}
+
+extern
+pprim(v, nv, tex, color)
+int *v;
+struct PL_TEX *tex;
+{
+    /* makes the indices of the ring the ones after the temp vertices */
+    vbase = -POMAXV;
+    rpoly(v, nv, tex, color, 1);
+}
+
+/* draw object with the current model+view, its size is already checked */
+static
+odrw(o)
+struct PL_OBJ *o;
+{
+    extern xfvecs();
+    extern int ctests(), mscl(), xfeye();
+    register struct PL_CHK *k, *end;
+    struct PL_CHK whole;
+    int res, r, s, sc;
+    int c[PVLEN], e[PVLEN];
+
+    res = PCCX;
+    sc = PONE;
+    if (o->brad > 0) {
+        xfvecs(o->bcen, c, 1);
+        sc = mscl();
+        res = ctests(c, ((o->brad * sc) >> PP) + 1);
+        if (res == PCCB) {
+            return;
+        }
+    }
+    s = 0;
+    if (o->brad > 0) {
+        s = xfeye(e);
+    }
+    if (o->ck == NULL) {
+        whole.ckv  = 0;
+        whole.cknv = o->nc;
+        whole.ckp  = 0;
+        whole.cknp = o->np;
+        orng(o, &whole, e, s, res);
+        return;
+    }
+    /* the chunks of a large object are culled on their own */
+    end = o->ck + o->nck;
+    for (k = o->ck; k < end; k++) {
+        r = res;
+        if (r != PCCI) {
+            xfvecs(k->ckcen, c, 1);
+            r = ctests(c, ((k->ckrad * sc) >> PP) + 1);
+            if (r == PCCB) { continue; }
+        }
+        orng(o, k, e, s, r);
     }
 }
 
 odraw(o)
 struct PL_OBJ *o;
 {
-    extern uerror(), xfvecs();
-    register i;
+    extern uerror(), dlput();
 
     if (!o) return;
-
-    if (o->nc >= POMAXV) {
+    if (dlrec) {
+        dlput(o);
+        return;
+    }
+    o = olsel(o);
+    if ((o->nc >= POMAXV) && (o->ck == NULL)) {
         uerror(PERR_MISC, "objmgr", "too many object vertices!");
         return;
     }
+    odrw(o);
+}
 
-    xfvecs(o->c, tv, o->nc);
-    for (i = 0; i < o->np; i++) {
-        rpoly(&o->p[i]);
+oinst(o, m, n)
+struct PL_OBJ *o;
+register mty *m;
+register n;
+{
+    extern uerror(), dlput(), mstpush(), mstpop(), mstld();
+    register struct PL_OBJ *l;
+    
+    if (!o) return;
+    /* every level of detail is checked once for all instances */
+    for (l = o; l; l = l->lnext) {
+        if ((l->nc >= POMAXV) && (l->ck == NULL)) {
+            uerror(PERR_MISC, "objmgr", "too many object vertices!");
+            return;
+        }
+    }
+    mstpush();
+    while (n-- > 0) {
+        mstld(m);
+        if (dlrec) {
+            dlput(o);
+        } else {
+            odrw(olsel(o));
+        }
+        m =+ 16;
     }
+    mstpop();
 }
 
 odel(o)
@@ -142,6 +432,457 @@ struct PL_OBJ *o;
     }
     o->p  = NULL;
     o->np = 0;
+    /* a mapped object doesn't own its arrays, they are in the image */
+    if (o->oimg == NULL) {
+        if (o->ck) {
+            umemfr(o->ck);
+        }
+        if (o->cvtx) {
+            umemfr(o->cvtx);
+            umemfr(o->cply);
+            umemfr(o->cpool);
+        }
+        if (o->txtab) {
+            umemfr(o->txtab);
+        }
+    }
+    o->ck  = NULL;
+    o->nck = 0;
+    o->cvtx  = NULL;
+    o->cply  = NULL;
+    o->cpool = NULL;
+    o->txtab = NULL;
+    o->ntx   = 0;
+    o->oimg  = NULL;
+    o->brad = 0;
+    o->lnext = NULL;
+    o->ldist = 0;
+}
+
+olod(o, l, dist)
+register struct PL_OBJ *o;
+struct PL_OBJ *l;
+{
+    while (o->lnext) {
+        o = o->lnext;
+    }
+    o->lnext = l;
+    o->ldist = dist;
+}
+
+/* plane through the first three vertices of a polygon. the normal is
+ * kept under 2^10 so its dot product with an object space position
+ * stays in range */
+static
+pplane(p, c)
+register struct PL_POLY *p;
+int *c;
+{
+    register int *a, *b;
+    register k;
+    int u[3], w[3], m;
+    
+    a = c + p->v[0] * PVLEN;
+    b = c + p->v[3] * PVLEN;
+    for (k = 0; k < 3; k++) {
+        u[k] = b[k] - a[k];
+    }
+    b = c + p->v[6] * PVLEN;
+    for (k = 0; k < 3; k++) {
+        w[k] = b[k] - a[k];
+    }
+    m = 0;
+    for (k = 0; k < 3; k++) {
+        if ( u[k] > m) { m =  u[k]; }
+        if (-u[k] > m) { m = -u[k]; }
+        if ( w[k] > m) { m =  w[k]; }
+        if (-w[k] > m) { m = -w[k]; }
+    }
+    while (m >= 040000) {
+        m =>> 1;
+        for (k = 0; k < 3; k++) {
+            u[k] =>> 1;
+            w[k] =>> 1;
+        }
+    }
+    p->pnrm[0] = u[1] * w[2] - u[2] * w[1];
+    p->pnrm[1] = u[2] * w[0] - u[0] * w[2];
+    p->pnrm[2] = u[0] * w[1] - u[1] * w[0];
+    m = 0;
+    for (k = 0; k < 3; k++) {
+        if ( p->pnrm[k] > m) { m =  p->pnrm[k]; }
+        if (-p->pnrm[k] > m) { m = -p->pnrm[k]; }
+    }
+    while (m >= 02000) {
+        m =>> 1;
+        for (k = 0; k < 3; k++) {
+            p->pnrm[k] =>> 1;
+        }
+    }
+    p->pdst = p->pnrm[0] * a[0] + p->pnrm[1] * a[1] + p->pnrm[2] * a[2];
+}
+
+/* bounding box of n vertices */
+static
+vbox(c, n, mn, mx)
+register int *c;
+register n;
+int *mn, *mx;
+{
+    register k;
+    
+    for (k = 0; k < 3; k++) {
+        mn[k] =  077777777;
+        mx[k] = -077777777;
+    }
+    while (n-- > 0) {
+        for (k = 0; k < 3; k++) {
+            if (c[k] < mn[k]) { mn[k] = c[k]; }
+            if (c[k] > mx[k]) { mx[k] = c[k]; }
+        }
+        c =+ PVLEN;
+    }
+}
+
+/* bounding sphere of n vertices, returns the radius */
+static int
+bsph(c, n, cen)
+int *c, *cen;
+{
+    extern int isqrt();
+    register int *v;
+    register i, d;
+    int k, sh, m, mn[3], mx[3];
+    
+    vbox(c, n, mn, mx);
+    sh = 0;
+    for (k = 0; k < 3; k++) {
+        cen[k] = (mn[k] + mx[k]) >> 1;
+        /* keep the sum of squares from overflowing */
+        while (((mx[k] - mn[k]) >> sh) >= 040000) {
+            sh++;
+        }
+    }
+    m = 0;
+    v = c;
+    for (i = 0; i < n; i++) {
+        d = 0;
+        for (k = 0; k < 3; k++) {
+            d =+ ((v[k] - cen[k]) >> sh) * ((v[k] - cen[k]) >> sh);
+        }
+        if (d > m) { m = d; }
+        v =+ PVLEN;
+    }
+    /* round up for the truncation of the shift and the root */
+    return((isqrt(m) + 2) << sh);
+}
+
+/* most vertices in a chunk, the same limit as for a whole object */
+#define CKMAXV  (POMAXV - 1)
+
+/* number of vertices of polygon not yet in chunk cur */
+static int
+pnew(p, stamp, cur)
+register struct PL_POLY *p;
+register int *stamp;
+{
+    register i, j, n;
+    
+    n = 0;
+    for (i = 0; i < p->nv; i++) {
+        if (stamp[p->v[i * 3]] == cur) { continue; }
+        for (j = 0; j < i; j++) {
+            if (p->v[j * 3] == p->v[i * 3]) { break; }
+        }
+        if (j == i) { n++; }
+    }
+    return(n);
+}
+
+/* split an object with too many vertices to draw at once into chunks.
+ * the polygons are sorted along a space filling curve first so each
+ * chunk covers a small part of the object and can be culled on its own.
+ * vertices shared by polygons in different chunks are duplicated,
+ * unused vertices are dropped. returns 0 if out of memory */
+static int
+ochunk(o)
+register struct PL_OBJ *o;
+{
+    extern char *umemgt();
+    extern umemfr(), bufcpy(), bufset();
+    register struct PL_POLY *p;
+    register i, j;
+    struct PL_POLY *np;
+    struct PL_CHK *ck;
+    int *key, *ord, *stamp, *vmap, *nc;
+    int pass, n, k, v, b, cur, cv, tot, q[3], sh[3], mn[3], mx[3];
+    
+    key = umemgt(o->np, sizeof(int));
+    ord = umemgt(o->np, sizeof(int));
+    stamp = umemgt(o->nc, sizeof(int));
+    vmap = umemgt(o->nc, sizeof(int));
+    np = NULL;
+    nc = NULL;
+    ck = NULL;
+    if (!key || !ord || !stamp || !vmap) { goto nomem; }
+    
+    /* morton order of the polygon centers in 8 bits per axis */
+    vbox(o->c, o->nc, mn, mx);
+    for (k = 0; k < 3; k++) {
+        sh[k] = 0;
+        while (((mx[k] - mn[k]) >> sh[k]) >= 0400) {
+            sh[k]++;
+        }
+    }
+    for (i = 0; i < o->np; i++) {
+        p = &o->p[i];
+        for (k = 0; k < 3; k++) {
+            q[k] = 0;
+            for (j = 0; j < p->nv; j++) {
+                q[k] =+ o->c[p->v[j * 3] * PVLEN + k] - mn[k];
+            }
+            q[k] = (q[k] / p->nv) >> sh[k];
+        }
+        key[i] = 0;
+        for (b = 7; b >= 0; b--) {
+            for (k = 0; k < 3; k++) {
+                key[i] = (key[i] << 1) | ((q[k] >> b) & 1);
+            }
+        }
+        ord[i] = i;
+    }
+    /* shell sort */
+    for (n = o->np >> 1; n > 0; n =>> 1) {
+        for (i = n; i < o->np; i++) {
+            v = ord[i];
+            for (j = i; (j >= n) && (key[ord[j - n]] > key[v]); j =- n) {
+                ord[j] = ord[j - n];
+            }
+            ord[j] = v;
+        }
+    }
+    
+    /* the first pass counts, the second fills */
+    for (pass = 0; pass < 2; pass++) {
+        bufset(stamp, 0, o->nc * sizeof(int));
+        cur = 1;
+        cv = 0;
+        tot = 0;
+        k = 0;
+        for (i = 0; i < o->np; i++) {
+            p = &o->p[ord[i]];
+            n = pnew(p, stamp, cur);
+            if ((cv + n) > CKMAXV) {
+                if (pass) {
+                    ck[cur - 1].cknv = cv;
+                    ck[cur - 1].cknp = i - k;
+                    ck[cur].ckv = tot;
+                    ck[cur].ckp = i;
+                }
+                k = i;
+                cur++;
+                cv = 0;
+                n = pnew(p, stamp, cur);
+            }
+            if (pass) {
+                bufcpy(&np[i], p, sizeof(struct PL_POLY));
+            }
+            for (j = 0; j <= p->nv; j++) {
+                v = p->v[j * 3];
+                if (stamp[v] != cur) {
+                    stamp[v] = cur;
+                    vmap[v] = tot++;
+                    if (pass) {
+                        bufcpy(&nc[vmap[v] * PVLEN], &o->c[v * PVLEN],
+                               PVLEN * sizeof(int));
+                    }
+                    cv++;
+                }
+                if (pass) {
+                    np[i].v[j * 3] = vmap[v];
+                }
+            }
+        }
+        if (pass == 0) {
+            nc = umemgt(tot * PVLEN, sizeof(int));
+            np = umemgt(o->np, sizeof(struct PL_POLY));
+            ck = umemgt(cur, sizeof(struct PL_CHK));
+            if (!nc || !np || !ck) { goto nomem; }
+            ck[0].ckv = 0;
+            ck[0].ckp = 0;
+        } else {
+            ck[cur - 1].cknv = cv;
+            ck[cur - 1].cknp = o->np - k;
+        }
+    }
+    umemfr(key);
+    umemfr(ord);
+    umemfr(stamp);
+    umemfr(vmap);
+    umemfr(o->c);
+    umemfr(o->p);
+    o->c = nc;
+    o->nc = tot;
+    o->p = np;
+    o->ck = ck;
+    o->nck = cur;
+    return(1);
+nomem:
+    if (key) { umemfr(key); }
+    if (ord) { umemfr(ord); }
+    if (stamp) { umemfr(stamp); }
+    if (vmap) { umemfr(vmap); }
+    if (nc) { umemfr(nc); }
+    if (np) { umemfr(np); }
+    if (ck) { umemfr(ck); }
+    return(0);
+}
+
+oprep(o)
+struct PL_OBJ *o;
+{
+    extern uerror();
+    register struct PL_CHK *k;
+    register i;
+    
+    /* the compact form keeps what was computed before converting */
+    if (o->cvtx) return;
+    o->brad = 0;
+    if (o->nc <= 0) return;
+    
+    if ((o->nc >= POMAXV) && (o->ck == NULL) && !ochunk(o)) {
+        uerror(PERR_NO_MEM, "objmgr", "no memory");
+        return;
+    }
+    for (k = o->ck; k < o->ck + o->nck; k++) {
+        k->ckrad = bsph(o->c + k->ckv * PVLEN, k->cknv, k->ckcen);
+    }
+    o->brad = bsph(o->c, o->nc, o->bcen);
+    
+    for (i = 0; i < o->np; i++) {
+        pplane(&o->p[i], o->c);
+    }
+}
+
+/* the compact form relies on chunks being small enough for 8 bit indices */
+#define CHAROK(x)  (((x) >= -0200) && ((x) < 0200))
+#define SHRTOK(x)  (((x) >= -0100000) && ((x) < 0100000))
+
+/* index of texture in the table plus one, adding it if it isn't there */
+static int
+txidx(t, tab, n)
+struct PL_TEX *t, **tab;
+int *n;
+{
+    register i;
+    
+    if (t == NULL) return(0);
+    for (i = 0; i < *n; i++) {
+        if (tab[i] == t) return(i + 1);
+    }
+    tab[(*n)++] = t;
+    return(*n);
+}
+
+extern int
+ocmpk(o)
+register struct PL_OBJ *o;
+{
+    extern char *umemgt();
+    extern umemfr(), bufcpy();
+    register struct PL_POLY *p;
+    register struct PL_CPLY *q;
+    register char *x;
+    struct PL_CHK *k, *end, whole;
+    struct PL_TEX **tt;
+    int i, j, n, nt;
+    
+    if (o->cvtx) return(1);
+    if (o->brad == 0) {
+        oprep(o);
+    }
+    if ((o->nc <= 0) || (o->np <= 0)) return(0);
+    for (i = 0; i < o->nc * PVLEN; i =+ PVLEN) {
+        for (j = 0; j < 3; j++) {
+            if (!SHRTOK(o->c[i + j])) return(0);
+        }
+    }
+    n = 0;
+    for (i = 0; i < o->np; i++) {
+        p = &o->p[i];
+        for (j = 0; j < p->nv; j++) {
+            if (!CHAROK(p->v[j * 3 + 1]) || !CHAROK(p->v[j * 3 + 2])) {
+                return(0);
+            }
+        }
+        n =+ p->nv;
+    }
+    tt = umemgt(o->np, sizeof(struct PL_TEX *));
+    o->cvtx = umemgt(o->nc * 3, sizeof(short));
+    o->cply = umemgt(o->np, sizeof(struct PL_CPLY));
+    o->cpool = umemgt(n * PPOLY_VLEN, sizeof(char));
+    if (!tt || !o->cvtx || !o->cply || !o->cpool) {
+        goto nomem;
+    }
+    for (i = 0; i < o->nc; i++) {
+        for (j = 0; j < 3; j++) {
+            o->cvtx[i * 3 + j] = o->c[i * PVLEN + j];
+        }
+    }
+    whole.ckv  = 0;
+    whole.ckp  = 0;
+    whole.cknp = o->np;
+    k = &whole;
+    end = k + 1;
+    if (o->ck) {
+        k = o->ck;
+        end = k + o->nck;
+    }
+    /* fewer than POMAXV vertices per chunk so the indices fit */
+    x = o->cpool;
+    nt = 0;
+    for (; k < end; k++) {
+        for (i = k->ckp; i < k->ckp + k->cknp; i++) {
+            p = &o->p[i];
+            q = &o->cply[i];
+            q->cptx = txidx(p->tex, tt, &nt);
+            q->cpcol = p->color;
+            q->cpdst = p->pdst;
+            for (j = 0; j < 3; j++) {
+                q->cpnrm[j] = p->pnrm[j];
+            }
+            q->cpnv = p->nv;
+            q->cpix = (x - o->cpool) / PPOLY_VLEN;
+            for (j = 0; j < p->nv; j++) {
+                *x++ = p->v[j * 3] - k->ckv;
+                *x++ = p->v[j * 3 + 1];
+                *x++ = p->v[j * 3 + 2];
+            }
+        }
+    }
+    o->txtab = NULL;
+    o->ntx = nt;
+    if (nt > 0) {
+        o->txtab = umemgt(nt, sizeof(struct PL_TEX *));
+        if (o->txtab == NULL) { goto nomem; }
+        bufcpy(o->txtab, tt, nt * sizeof(struct PL_TEX *));
+    }
+    umemfr(tt);
+    umemfr(o->c);
+    umemfr(o->p);
+    o->c = NULL;
+    o->p = NULL;
+    return(1);
+nomem:
+    if (tt) { umemfr(tt); }
+    if (o->cvtx) { umemfr(o->cvtx); }
+    if (o->cply) { umemfr(o->cply); }
+    if (o->cpool) { umemfr(o->cpool); }
+    o->cvtx = NULL;
+    o->cply = NULL;
+    o->cpool = NULL;
+    o->ntx = 0;
+    return(0);
 }
 
 ocpy(d, s)
@@ -150,6 +891,7 @@ struct PL_OBJ *d, *s;
     extern char *umemgt();
     extern uerror(), bufcpy();
     register i, size;
+    int n;
     
     if (!s) {
         uerror(PERR_MISC, "objmgr", "objcpy null src");
@@ -160,7 +902,7 @@ struct PL_OBJ *d, *s;
         return;
     }
     odel(d);
-    if (s->nc > 0) {
+    if (s->c && (s->nc > 0)) {
         size = s->nc * PVLEN * sizeof(int);
         d->c = umemgt(1, size);
         if (d->c == NULL) {
@@ -175,7 +917,7 @@ struct PL_OBJ *d, *s;
         d->c  = NULL;
         d->nc = 0;
     }
-    if (s->np > 0) {
+    if (s->p && (s->np > 0)) {
         size = s->np * sizeof(struct PL_POLY);
         d->p = umemgt(1, size);
         if (d->p == NULL) {
@@ -188,6 +930,172 @@ struct PL_OBJ *d, *s;
         d->p  = NULL;
         d->np = 0;
     }
+    if (s->nck > 0) {
+        size = s->nck * sizeof(struct PL_CHK);
+        d->ck = umemgt(1, size);
+        if (d->ck == NULL) {
+            uerror(PERR_NO_MEM, "objmgr", "no memory");
+            return;
+        }
+        bufcpy(d->ck, s->ck, size);
+        d->nck = s->nck;
+    }
+    if (s->cvtx) {
+        n = 0;
+        for (i = 0; i < s->np; i++) {
+            n =+ s->cply[i].cpnv;
+        }
+        d->cvtx = umemgt(s->nc * 3, sizeof(short));
+        d->cply = umemgt(s->np, sizeof(struct PL_CPLY));
+        d->cpool = umemgt(n * PPOLY_VLEN, sizeof(char));
+        if (!d->cvtx || !d->cply || !d->cpool) {
+            uerror(PERR_NO_MEM, "objmgr", "no memory");
+            return;
+        }
+        bufcpy(d->cvtx, s->cvtx, s->nc * 3 * sizeof(short));
+        bufcpy(d->cply, s->cply, s->np * sizeof(struct PL_CPLY));
+        bufcpy(d->cpool, s->cpool, n * PPOLY_VLEN);
+        d->nc = s->nc;
+        d->np = s->np;
+        if (s->ntx > 0) {
+            size = s->ntx * sizeof(struct PL_TEX *);
+            d->txtab = umemgt(1, size);
+            if (d->txtab == NULL) {
+                uerror(PERR_NO_MEM, "objmgr", "no memory");
+                return;
+            }
+            bufcpy(d->txtab, s->txtab, size);
+            d->ntx = s->ntx;
+        }
+    }
+    bufcpy(d->bcen, s->bcen, sizeof(s->bcen));
+    d->brad = s->brad;
+    d->lnext = s->lnext;
+    d->ldist = s->ldist;
+}
+
+extern int
+asize(a, cap, n, sz)
+char **a;
+int *cap;
+{
+    extern char *umemgt();
+    extern umemfr(), bufcpy(), uerror();
+    register char *b;
+    
+    if (n == *cap) return(1);
+    b = umemgt(n, sz);
+    if (b == NULL) {
+        uerror(PERR_NO_MEM, "objmgr", "no memory");
+        return(0);
+    }
+    if (*a) {
+        bufcpy(b, *a, ((n < *cap) ? n : *cap) * sz);
+        umemfr(*a);
+    }
+    *a = b;
+    *cap = n;
+    return(1);
+}
+
+extern int
+agrow(a, cap, n, sz)
+char **a;
+int *cap;
+{
+    register c;
+    
+    if (n <= *cap) return(1);
+    c = *cap ? *cap : 64;
+    while (c < n) {
+        c =<< 1;
+    }
+    return(asize(a, cap, c, sz));
+}
+
+#define VHASH(x, y, z) (((x) * 73856093) ^ ((y) * 19349663) ^ ((z) * 83492791))
+
+/* size the hash for twice the n vertices of c and enter them again */
+static int
+vhsize(h, c, n)
+register struct PL_VH *h;
+int *c;
+{
+    extern char *umemgt();
+    extern umemfr(), bufset(), uerror();
+    register i, k, *v;
+    int m;
+    
+    m = h->vhcap ? h->vhcap : 256;
+    while (m <= (n << 1)) {
+        m =<< 1;
+    }
+    if (m != h->vhcap) {
+        if (h->vhtab) {
+            umemfr(h->vhtab);
+        }
+        h->vhtab = umemgt(m, sizeof(int));
+        h->vhcap = 0;
+        if (h->vhtab == NULL) {
+            uerror(PERR_NO_MEM, "objmgr", "no memory");
+            return(0);
+        }
+        h->vhcap = m;
+    }
+    bufset(h->vhtab, 0, m * sizeof(int));
+    for (i = 0; i < n; i++) {
+        v = c + i * PVLEN;
+        k = VHASH(v[0], v[1], v[2]) & (m - 1);
+        while (h->vhtab[k]) {
+            k = (k + 1) & (m - 1);
+        }
+        h->vhtab[k] = i + 1;
+    }
+    return(1);
+}
+
+extern int
+vhget(h, c, n, x, y, z)
+register struct PL_VH *h;
+int *c;
+{
+    register i, k, *v;
+    
+    if ((n << 1) >= h->vhcap) {
+        if (!vhsize(h, c, n)) return(-1);
+    }
+    k = VHASH(x, y, z) & (h->vhcap - 1);
+    while ((i = h->vhtab[k]) != 0) {
+        v = c + (i - 1) * PVLEN;
+        if ((v[0] == x) && (v[1] == y) && (v[2] == z)) {
+            return(i - 1);
+        }
+        k = (k + 1) & (h->vhcap - 1);
+    }
+    h->vhtab[k] = n + 1;
+    return(n);
+}
+
+vhclr(h)
+struct PL_VH *h;
+{
+    extern bufset();
+    
+    if (h->vhtab) {
+        bufset(h->vhtab, 0, h->vhcap * sizeof(int));
+    }
+}
+
+vhdel(h)
+struct PL_VH *h;
+{
+    extern umemfr();
+    
+    if (h->vhtab) {
+        umemfr(h->vhtab);
+    }
+    h->vhtab = NULL;
+    h->vhcap = 0;
 }
 
 int
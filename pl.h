@@ -23,12 +23,13 @@
 /********************************* CLIPPING **********************************/
 /*****************************************************************************/
 
-#define PCCI  00   /* in front of z plane */
-#define PCCX  01   /* crossing z plane */
-#define PCCB  02   /* completely behind z plane */
+#define PCCI  00   /* between near and far z planes */
+#define PCCX  01   /* crossing a z plane */
+#define PCCB  02   /* completely behind near or beyond far z plane */
 
 extern vpminx, vpmaxx, vpminy, vpmaxy;
 extern vpcenx, vpceny;
+extern vpfar; /* view space z of the far plane */
 
 /* define viewport
  * 
@@ -44,16 +45,54 @@ extern int cliney(); /* clip line y */
 extern int cpolyx(); /* clip poly x */
 extern int cpolyy(); /* clip poly y */
 
+/* frustum outcodes of a view space vertex. a vertex may project onto
+ * the viewport edge pixels when only the side bit is set, the polygon
+ * needs a 2D test then. with the POX bit as well it is surely outside */
+#define POCN  001  /* behind near plane */
+#define POCL  002  /* left of viewport */
+#define POCR  004  /* right of viewport */
+#define POCT  010  /* above viewport */
+#define POCB  020  /* below viewport */
+#define POCS  036  /* any side of the viewport */
+#define POCF  040  /* beyond far plane */
+#define POCZ  041  /* outside either z plane */
+#define POXL  0100 /* surely left of viewport */
+#define POXR  0200 /* surely right of viewport */
+#define POXT  0400 /* surely above viewport */
+#define POXB  01000 /* surely below viewport */
+#define POCX  01741 /* planes a polygon is rejected by */
+#define POCU  (-1) /* vertex not used, xfcvec() leaves it alone */
+
+/* number of values filled in by cobnds() */
+#define PCOBND  12
+/* get the values the outcodes of xfcvec() and xfsvec() are computed from:
+ * fov shift, bound shift, left, right, top, bottom, near z, far z,
+ * then left, right, top and bottom again for the POX bits */
+extern cobnds();
+
+/* results of testing a projected polygon against the viewport */
+#define PCVI  00   /* inside viewport */
+#define PCVG  01   /* inside guard band, only needs spans clamped */
+#define PCVX  02   /* crossing viewport, needs clipping */
+#define PCVO  03   /* completely outside viewport */
+
+/* test screen space bounding box of a projected polygon against viewport */
+extern int ctestv();
+
 /* test z bounds to determine its position relative to near plane */
 extern int ctestz();
-/* clip polygon to near plane */
+/* test a view space bounding sphere against the view frustum
+ * (*center, radius) returns PCCI, PCCX or PCCB */
+extern int ctests();
+/* clip polygon to near and far planes */
 extern int cpolyz();
 
 /*****************************************************************************/
 /********************************** ENGINE ***********************************/
 /*****************************************************************************/
 
-/* maximum number of vertices in object */
+/* maximum number of vertices transformed at once,
+ * larger objects are drawn in chunks */
 #define POMAXV  128
 
 #define PRFLAT  1
@@ -66,6 +105,7 @@ extern int cpolyz();
 /* for storage size definition */
 #define PVDIM       5  /* X Y Z U V */
 #define PPOLY_VLEN  3  /* Idx U V */
+#define PPMAXE      8  /* max verts in a user defined polygon */
 
 extern vfov; /* min valid value = 8 */
 extern rastm; /* PRFLAT or PRTEX */
@@ -74,12 +114,37 @@ extern cullm; /* cull mode */
 struct PL_POLY {
     struct PL_TEX *tex;
     
-    /* a user defined polygon may only have 3 or 4 vertices.  */
+    /* a user defined polygon has 3 to PPMAXE vertices and must be
+     * convex and flat. */
     
-    /* [index, U, V] array of indices into obj verts array */
-    int v[6 * PPOLY_VLEN]; 
+    /* [index, U, V] array of indices into obj verts array,
+     * the first vertex is repeated after the last */
+    int v[(PPMAXE + 1) * PPOLY_VLEN]; 
     int color;
     int nv;
+    
+    /* plane of the first three vertices in object space, set by oprep() */
+    int pnrm[3];
+    int pdst;
+};
+
+/* polygon of the compact object form, see ocmpk() */
+struct PL_CPLY {
+    int cpcol;     /* color */
+    int cpdst;     /* plane, same as pnrm and pdst */
+    int cpix;      /* first [index, U, V] entry in the pool of the object */
+    short cpnrm[3];
+    short cptx;    /* texture, index into txtab plus one or 0 if none */
+    char cpnv;     /* number of vertices */
+};
+
+/* range of an object's vertices and the polygons using only them,
+ * small enough to be transformed at once */
+struct PL_CHK {
+    int ckv, cknv; /* first vertex and number of vertices */
+    int ckp, cknp; /* first polygon and number of polygons */
+    int ckcen[3];  /* center of bounding sphere */
+    int ckrad;     /* radius of bounding sphere */
 };
 
 struct PL_OBJ {
@@ -87,21 +152,91 @@ struct PL_OBJ {
     int *c;  /* coords: array of [x, y, z, 0] values */
     int  np; /* num polys */
     int  nc; /* num coords */
+    /* chunks of an object with POMAXV or more vertices, made by oprep() */
+    struct PL_CHK *ck;
+    int  nck; /* num chunks */
+    /* compact form made by ocmpk(), c and p are NULL when it is used */
+    short *cvtx; /* coords: array of [x, y, z] values */
+    struct PL_CPLY *cply; /* polygons */
+    char *cpool; /* pool of [index, U, V], indices relative to the chunk */
+    struct PL_TEX **txtab; /* textures used by cply */
+    int  ntx; /* num textures */
+    char *oimg; /* image the object is mapped from, NULL if not mapped */
+    int  bcen[3]; /* center of bounding sphere */
+    int  brad; /* radius of bounding sphere, 0 if not computed */
+    struct PL_OBJ *lnext; /* coarser level of detail, NULL if none */
+    int  ldist; /* view space z from which lnext is drawn instead */
 };
 
 extern odraw(); /* draw object */
+/* draw object once for each model matrix in an array, the mst is left
+ * unchanged (*obj, *matrices, num instances) */
+extern oinst();
 extern odel(); /* delete object */
 extern ocpy(); /* copy object */
+/* compute bounding sphere and polygon planes of object. an object with
+ * too many vertices to draw at once is split into chunks, which reorders
+ * its polygons and vertices */
+extern oprep();
+
+/* vertices kept by pvtx() for drawing without an object */
+#define PRING   (PPMAXE + 1)
+
+/* transform vertex with the current model+view and project it,
+ * keeping it in the ring (slot, x, y, z) */
+extern pvtx();
+/* draw polygon of vertices kept by pvtx() ([slot, U, V] list with the
+ * first repeated at the end, num verts, *tex, color) */
+extern pprim();
+
+/* convert object to the compact form, which stores vertices as shorts
+ * and polygons without their unused vertex slots. returns 0 if it has
+ * coordinates or texture coordinates out of range or there is no memory,
+ * the object is left unchanged then. oprep() can't be used afterwards */
+extern int ocmpk();
+/* append a coarser level of detail to an object
+ * (*obj, *lod, view space z to switch at) */
+extern olod();
+
+/* draw polygon already in view space.
+ * (*v, stream type, num edges, OR of vertex outcodes, *tex, color) */
+extern pvpoly();
+
+/* make room for n elements of size sz in the array *a, which has room
+ * for *cap, doubling its size. returns 0 if out of memory
+ * (**a, *cap, n, sz) */
+extern int agrow();
+/* resize the array *a to exactly n elements (**a, *cap, n, sz) */
+extern int asize();
+
+/* hash of vertex positions for welding vertices that are equal */
+struct PL_VH {
+    int *vhtab; /* vertex index plus one, 0 if empty */
+    int vhcap;  /* entries, a power of two */
+};
+
+/* index of the vertex at x, y, z among the n [x, y, z, 0] vertices in c,
+ * or n if there is none. it is then recorded as vertex n, which c must
+ * have room for and which must be stored before the next call.
+ * returns -1 if out of memory
+ * (*hash, *c, n, x, y, z) */
+extern int vhget();
+extern vhclr(); /* forget all vertices, keeping the memory */
+extern vhdel(); /* free the hash */
 
 /*****************************************************************************/
 /*********************************** IMODE ***********************************/
 /*****************************************************************************/
 
-#define PTRIS   0
-#define PQUADS  1
+#define PTRIS    0
+#define PQUADS   1
+#define PSTRIP   2 /* triangles sharing two vertices with the one before */
+#define PFAN     3 /* triangles sharing the first vertex */
+#define PPOLYGON 4 /* one polygon of up to PPMAXE vertices */
 
 extern imbeg(); /* begin primitive */
-/* type is PTRIS or PQUADS */
+/* type is one of the above. calling it again with PSTRIP, PFAN or
+ * PPOLYGON ends the strip, fan or polygon and starts a new one */
 extern imtype();
 
 /* applies to the next polygon made. */
@@ -114,10 +249,20 @@ extern imvtx(); /* vertex */
 /* doesn't delete the previous object once called */
 extern imend(); /* end primitive */
 
+/* on nonzero, primitives are drawn as soon as their last vertex is
+ * entered, with the camera and mst at the time each vertex is entered,
+ * instead of being added to an object. nothing is allocated. on 0 goes
+ * back to making objects. streamed primitives can't be recorded in a
+ * display list */
+extern imstrm();
+
+/* iminit() and imexport() take the object made by imend() without
+ * copying it, so only one of them can be used for each object */
 extern iminit(); /* initialize (only needed if not exporting) */
 extern imdraw(); /* render (only needed if not exporting) */
 
-/* save current model that has been defined in immediate mode */
+/* move current model that has been defined in immediate mode to the
+ * object, whatever it held is overwritten */
 extern imexport();
 
 /*****************************************************************************/
@@ -128,7 +273,10 @@ extern imexport();
 #define PTLOG   7
 #define PTDIM   (1 << PTLOG)
 
-#define PPMAXV  8  /* max verts in a polygon (post-clip) */
+/* max verts in a polygon (post-clip). clipping to the near and far
+ * planes and then the sides of the viewport adds up to four, plus one
+ * for the copy of the first at the end */
+#define PPMAXV  (PPMAXE + 5)
 
 #define PSFLAT  3  /* X Y Z */
 #define PSTEX   5  /* X Y Z U V */
@@ -140,9 +288,29 @@ typedef short dty; /* depth buffer type */
 extern int *pvideo;
 extern dty *pdepth;
 
+/* 2D clipping needed by the next polygon fill, a ctestv() result.
+ * it is reset to PCVX by every fill */
+extern pscanm;
+
+/* texel value drawn as transparent by textures with the PTFKEY flag.
+ * c18to24 never produces it */
+#define PTKEY   0370
+
+#define PTFKEY  01 /* texture flag: PTKEY texels are transparent */
+
 /* only square textures with dimensions of PTDIM */
 struct PL_TEX {
     int *texdat;
+    int txflg; /* texture flags */
+    
+    /* the rest is only used for textures managed by the texture cache.
+     * a texture without a loader is owned by the program and is
+     * always considered resident.
+     */
+    int (*txload)(); /* fill texel data: (*tex, *texdat), 0 on failure */
+    int txid;        /* for the program to identify the texture */
+    int txlast;      /* frame number of last use */
+    struct PL_TEX *txprev, *txnext; /* LRU list links */
 };
 
 /* Call this to initialize PL
@@ -159,6 +327,15 @@ extern int c18to24();
 
 /* clear entire screen color and depth */
 extern pc();
+/* clear entire screen to the given color and clear depth */
+extern pcfill();
+
+/* Direct rendering into a texture.
+ * Everything drawn afterwards goes into the texels of the texture
+ * with its own viewport and depth buffer.
+ * Call with NULL to render to the screen again.
+ */
+extern ptgt();
 
 /* Solid color polygon fill.
  * Expecting input stream of 3 values [X,Y,Z] */
@@ -167,6 +344,55 @@ extern pfpoly();
 /* Affine (linear) texture mapped polygon fill.
  * Expecting input stream of 5 values [X,Y,Z,U,V] */
 extern ptpoly();
+/* Same as ptpoly but texels with the value PTKEY are not drawn */
+extern pkpoly();
+
+/*****************************************************************************/
+/********************************* IMPOSTOR **********************************/
+/*****************************************************************************/
+
+/* An impostor is an image of an object rendered into a texture that is
+ * drawn as a single quad in place of the object until the direction
+ * the object is viewed from changes too much.
+ */
+struct PL_IMP {
+    struct PL_TEX iptex; /* image of the object */
+    int ipkey[6]; /* view of the object the image was made with */
+    int iphsz;    /* half size of the quad in view space */
+    int ipthr;    /* how much the view may change, 256 = 90 degrees */
+    int ipok;     /* image is valid, clear to force re-rendering */
+};
+
+/* allocate the image of an impostor, returns 0 if out of memory
+ * (*imp, threshold) */
+extern int ipinit();
+extern ipdel(); /* free the image of an impostor */
+/* draw object using the impostor, the object is drawn normally when
+ * rastm isn't PRTEX or it is too close or too large on screen to use
+ * an impostor. while a display list is recorded the object itself is
+ * recorded, wherever it is
+ * (*imp, *obj) */
+extern ipdraw();
+
+/*****************************************************************************/
+/******************************* TEXTURE CACHE *******************************/
+/*****************************************************************************/
+
+/* size in bytes of the texel data of one texture */
+#define PTSIZE  (PTDIM * PTDIM * sizeof(int))
+
+extern tcbudg; /* memory budget in bytes for resident textures */
+extern tcused; /* bytes currently used by resident textures */
+extern tchits; /* number of uses where the texture was resident */
+extern tcmiss; /* number of uses where the texture had to be loaded */
+
+/* make sure texture is resident, loading it if needed.
+ * returns its texel data or NULL if it could not be loaded */
+extern int *tcuse();
+/* evict texture from memory, it will be reloaded on its next use */
+extern tcdel();
+/* advance frame counter, call once per frame */
+extern tcfrm();
 
 /*****************************************************************************/
 /*********************************** MATH ************************************/
@@ -183,6 +409,9 @@ extern ptpoly();
 #define PP             7
 #define PONE           (1 << PP)
 
+/* depth of the matrix stack */
+#define PMSTACK        16
+
 extern int PL_sin[PTRIGMAX];
 extern int PL_cos[PTRIGMAX];
 
@@ -192,8 +421,14 @@ typedef short mty; /* matrix type */
 /* matrices are assumed to be integer arrays of length 16 */
 
 extern int porder();
+extern int isqrt(); /* integer square root */
+extern int vdist(); /* distance between two points, rounded up */
+extern int recip(); /* 2^30 / z for z > 0, approximated without dividing */
 extern vshort(); /* shorten vector to fit in 15 bits */
 extern psproj(); /* perspective project */
+/* perspective project a stream of [x, y, z, outcode] vertices to
+ * [x, y, depth, outcode], skipping the ones behind the near plane */
+extern psvtx();
 
 /* matrix stack (mst) */
 extern mstget(); /* get current top of mst */
@@ -207,15 +442,166 @@ extern mtrans(); /* translate by x, y, z */
 extern mrotx(); /* rotate x */
 extern mroty(); /* y */
 extern mrotz(); /* z */
-extern defcam(); /* define camera */
+extern defcam(); /* define camera (x, y, z, rx, ry, rz) */
 
-/* transform a stream of vertices by the current model+view */
+/* transform a stream of vertices by the current model+view,
+ * the fourth element of each output vertex is cleared */
 extern xfvecs();
+/* same as xfvecs() but skips vertices whose output is marked POCU and
+ * also stores the outcode of each vertex if the last argument is set
+ * (*v, *out, len, outcodes) */
+extern xfcvec();
+/* same as xfcvec() but for a stream of [x, y, z] shorts */
+extern xfsvec();
+/* get the position of the eye in object space, returns the sign of the
+ * determinant of the model+view or 0 if it can't be represented */
+extern int xfeye();
+/* upper bound of how much the current model+view scales lengths, PONE = 1 */
+extern int mscl();
 
 /* result is stored in 'a' */
 extern mmul(); /* matrix mul */
 extern mcpy(); /* copy matrix */
 
+/*****************************************************************************/
+/*********************************** SCENE ***********************************/
+/*****************************************************************************/
+
+/* node flags, maintained by the scene functions */
+#define SNDIRT  01 /* local transform changed */
+#define SNBND   02 /* object or children changed */
+#define SNKID   04 /* a descendant changed */
+
+/* A scene is a tree of nodes, the transform of a node is relative to
+ * its parent. World matrices and bounds are cached in the nodes and
+ * only recomputed when something in their subtree changes.
+ */
+struct PL_NODE {
+    mty nloc[16]; /* transform relative to the parent */
+    mty nwld[16]; /* cached world transform */
+    struct PL_OBJ *nobj; /* object to draw, NULL if none */
+    struct PL_NODE *npar, *nkid, *nsib; /* parent, first child, next sibling */
+    int nflg;     /* node flags */
+    int nbcen[3]; /* world space bounding sphere of the node and children */
+    int nbrad;    /* 0 if there is nothing to draw */
+};
+
+extern sninit(); /* initialize node with identity transform (*node, *obj) */
+extern snadd(); /* add node as last child (*parent, *node) */
+extern snrem(); /* remove node from its parent */
+extern snset(); /* set transform of node to the top of mst */
+extern snobj(); /* change the object of a node */
+/* draw node and its children, skipping subtrees outside the frustum.
+ * the node is placed by its ancestors, whose tree is brought up to date
+ * first, the mst is left unchanged */
+extern sndraw();
+
+/*****************************************************************************/
+/******************************** DISPLAY LIST *******************************/
+/*****************************************************************************/
+
+/* recorded draw of an object */
+struct PL_DLE {
+    mty demat[16]; /* model matrix, without the camera */
+    struct PL_OBJ *deobj;
+    int derst, decul, defov; /* rastm, cullm and vfov */
+};
+
+struct PL_DL {
+    struct PL_DLE *dlent;
+    int dlcnt; /* number of recorded draws */
+    int dlcap; /* number of entries allocated */
+};
+
+/* list being recorded, NULL if none */
+extern struct PL_DL *dlrec;
+
+/* begin recording into list, discarding what it held before.
+ * a list that was never used must be zeroed.
+ * odraw() and ipdraw() calls are recorded instead of drawn until dlend(),
+ * an ipdraw() is recorded as an odraw() of its object */
+extern dlbeg();
+extern dlend(); /* end recording */
+extern dlput(); /* record object, used by odraw() */
+/* replay list under the current camera, the mst and render state
+ * are left unchanged */
+extern dlcall();
+extern dldel(); /* free list */
+
+/*****************************************************************************/
+/*********************************** IMAGE ***********************************/
+/*****************************************************************************/
+
+#define PIMAGIC 0x504c4f49 /* "PLOI" */
+#define PIMAGRV 0x494f4c50 /* magic of an image with the other byte order */
+#define PIVERS  1
+
+/* Header at the start of an object image. Offsets are in bytes from the
+ * start of the image and are multiples of the size of an int, so an
+ * image loaded at an int aligned address can be used where it is.
+ * Images are only read by builds with the same byte order and struct
+ * layout as the one that wrote them.
+ */
+struct PL_IMG {
+    int immag;  /* PIMAGIC */
+    int imver;  /* PIVERS */
+    int imsiz;  /* size of the whole image */
+    int imnc, imnp, imnck, imntx; /* vertices, polygons, chunks, textures */
+    int imcen[3], imrad; /* bounding sphere */
+    int imck;   /* chunks */
+    int imtx;   /* txid of each texture */
+    int impl;   /* polygons */
+    int imcv;   /* vertex coords */
+    int impo;   /* pool of [index, U, V] */
+};
+
+/* size of the image of an object, 0 if it can't be saved.
+ * converts the object to the compact form if it isn't already */
+extern int osize();
+/* write image of object into an int aligned buffer of osize() bytes
+ * (*obj, *buf), returns the size or 0 on failure.
+ * textures are stored as their txid, levels of detail aren't saved */
+extern int osave();
+/* use an image as an object without copying it (*obj, *buf, **tex).
+ * tex has a texture for each txid in oimtx(), in the same order.
+ * buf and tex must stay valid until odel() of the object.
+ * returns 0 if buf isn't an image this build can read, the object is
+ * left as it was then */
+extern int omap();
+extern int *oimtx(); /* txid of each texture in an image */
+
+/*****************************************************************************/
+/*********************************** MESH ************************************/
+/*****************************************************************************/
+
+/* load Wavefront OBJ or ASCII PLY text into an object
+ * (*obj, (*read)(), scale, *tex, color).
+ * read(buf, n) puts up to n bytes of the file in buf and returns how
+ * many, 0 at the end. coordinates are multiplied by scale and rounded,
+ * z is negated to match the engine and vertices that end up equal are
+ * welded. all polygons get the texture and color given.
+ * coordinates must fit in a short after scaling. the texture coordinates
+ * of a face are moved by whole texture periods to fit in a char, a face
+ * whose coordinates are more than a period apart may not fit.
+ * the object must be zeroed or valid, it is prepared with oprep().
+ * a mesh of more than 1024 polygons is made in the compact form, see
+ * ocmpk(). returns 0 if the file can't be read */
+extern int oload();
+
+/*****************************************************************************/
+/********************************* OPTIMIZER *********************************/
+/*****************************************************************************/
+
+/* reorder polygons of an object so they reuse the vertices of the ones
+ * drawn before them, grouped by texture, and renumber the vertices in
+ * the order they are first used. prepares the object if it wasn't.
+ * returns 0 if there is nothing to optimize or no memory */
+extern int oopt();
+/* average cache misses per triangle of the polygon order of an object
+ * with a FIFO cache of 16 vertices, times PONE. 0.5 is ideal, 3 is the
+ * worst there is */
+extern int oacmr();
+
 /*****************************************************************************/
 /************************************ GEN ************************************/
 /*****************************************************************************/
@@ -248,6 +634,15 @@ extern char *umemgt();
 /* user memory freeing function */
 extern umemfr();
 
+/* tags the engine accounts its memory to, the program may use others */
+#define PMOTHER  0 /* objects and anything not listed */
+#define PMTEX    1 /* texture cache and impostor images */
+#define PMIMODE  2 /* objects made in immediate mode */
+#define PMMESH   3 /* imported meshes */
+/* user function setting the tag of the memory allocated from now on,
+ * returns the previous tag */
+extern int umemtg();
+
 extern bufcpy(); /* (*to, *from, size) */
 extern bufset(); /* (*to, val, size) */
 
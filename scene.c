@@ -0,0 +1,267 @@
+/*****************************************************************************/
+/*
+ * Early C implementation of an extra lite version of the PiSHi engine.
+ * 
+ *   by EMMIR 2018-2022
+ *   
+ *   YouTube: https://www.youtube.com/c/LMP88
+ *   
+ * This software is released into the public domain.
+ */
+/*****************************************************************************/
+
+#include "pl.h"
+
+/*  scene.c
+ * 
+ * Scene graph. Every node has a transform relative to its parent and
+ * optionally an object to draw. The world matrix of each node and the
+ * bounding sphere of each subtree are kept from frame to frame and only
+ * recomputed for the parts of the tree that changed.
+ * 
+ */
+
+/* transform point by a world matrix */
+static
+wpt(m, v, out)
+register mty *m;
+register int *v, *out;
+{
+    register j;
+
+    for (j = 0; j < 3; j++) {
+        out[j] = ((v[0] * m[0 + j] + v[1] * m[4 + j] + v[2] * m[8 + j])
+                  >> PP) + m[12 + j];
+    }
+}
+
+/* grow the bounds of a node to also enclose the sphere (c, r) */
+static
+grow(n, c, r)
+register struct PL_NODE *n;
+register int *c;
+{
+    extern int vdist();
+    register k, d;
+    int nr, f;
+
+    if (n->nbrad <= 0) {
+        for (k = 0; k < 3; k++) {
+            n->nbcen[k] = c[k];
+        }
+        n->nbrad = r;
+        return;
+    }
+    d = vdist(n->nbcen, c);
+    if ((d + r) <= n->nbrad) {
+        return;
+    }
+    if ((d + n->nbrad) <= r) {
+        for (k = 0; k < 3; k++) {
+            n->nbcen[k] = c[k];
+        }
+        n->nbrad = r;
+        return;
+    }
+    /* move the center towards c, f is how far in 1/256ths of d */
+    nr = (d + r + n->nbrad) >> 1;
+    f = ((nr - n->nbrad) << 8) / d;
+    for (k = 0; k < 3; k++) {
+        n->nbcen[k] =+ ((c[k] - n->nbcen[k]) * f) >> 8;
+    }
+    /* cover the truncation of f */
+    n->nbrad = nr + (d >> 8) + 2;
+}
+
+/* set flag on node and let its ancestors know a descendant changed */
+static
+mark(n, f)
+register struct PL_NODE *n;
+{
+    n->nflg =| f;
+    for (n = n->npar; n && !(n->nflg & SNKID); n = n->npar) {
+        n->nflg =| SNKID;
+    }
+}
+
+/* bring the world matrices and bounds of a subtree up to date.
+ * pw is the world matrix of the parent, wchg is set if it changed.
+ * returns nonzero if the bounds of the subtree changed */
+static int
+snupd(n, pw, wchg)
+register struct PL_NODE *n;
+mty *pw;
+{
+    extern oprep(), mcpy(), mmul(), mstld();
+    extern int mscl();
+    register struct PL_NODE *k;
+    int bchg, c[3], r;
+
+    if (n->nflg & SNDIRT) {
+        wchg = 1;
+    }
+    if (!wchg && !(n->nflg & (SNKID | SNBND))) {
+        return(0);
+    }
+    if (wchg) {
+        if (pw) {
+            mcpy(n->nwld, pw);
+            mmul(n->nwld, n->nloc);
+        } else {
+            mcpy(n->nwld, n->nloc);
+        }
+    }
+    bchg = wchg || (n->nflg & SNBND);
+    n->nflg = 0;
+    for (k = n->nkid; k; k = k->nsib) {
+        if (snupd(k, n->nwld, wchg)) {
+            bchg = 1;
+        }
+    }
+    if (!bchg) {
+        return(0);
+    }
+    n->nbrad = 0;
+    if (n->nobj) {
+        if (n->nobj->brad == 0) {
+            oprep(n->nobj);
+        }
+        if (n->nobj->brad > 0) {
+            /* the camera doesn't scale so the model+view scales
+             * lengths as much as the world matrix alone */
+            mstld(n->nwld);
+            wpt(n->nwld, n->nobj->bcen, c);
+            r = ((n->nobj->brad * mscl()) >> PP) + 1;
+            grow(n, c, r);
+        }
+    }
+    for (k = n->nkid; k; k = k->nsib) {
+        if (k->nbrad > 0) {
+            grow(n, k->nbcen, k->nbrad);
+        }
+    }
+    return(1);
+}
+
+/* draw a subtree, in is set if it is known to be inside the frustum */
+static
+sndrn(n, in)
+register struct PL_NODE *n;
+{
+    extern odraw(), mstidt(), mstld(), xfvecs();
+    extern int ctests();
+    register struct PL_NODE *k;
+    int c[PVLEN], res, r;
+
+    if (n->nbrad <= 0) {
+        return;
+    }
+    if (!in) {
+        mstidt();
+        xfvecs(n->nbcen, c, 1);
+        /* the camera alone rotates the center slightly differently
+         * than the model+view used for the vertices */
+        r = (c[0] < 0 ? -c[0] : c[0]) + (c[1] < 0 ? -c[1] : c[1])
+          + (c[2] < 0 ? -c[2] : c[2]);
+        res = ctests(c, n->nbrad + (r >> 6) + 1);
+        if (res == PCCB) {
+            return;
+        }
+        in = (res == PCCI);
+    }
+    if (n->nobj) {
+        mstld(n->nwld);
+        odraw(n->nobj);
+    }
+    for (k = n->nkid; k; k = k->nsib) {
+        sndrn(k, in);
+    }
+}
+
+sninit(n, o)
+register struct PL_NODE *n;
+struct PL_OBJ *o;
+{
+    extern bufset();
+
+    bufset(n, 0, sizeof(struct PL_NODE));
+    n->nobj = o;
+    n->nloc[0]  = PONE;
+    n->nloc[5]  = PONE;
+    n->nloc[10] = PONE;
+    n->nloc[15] = PONE;
+    n->nflg = SNDIRT;
+}
+
+snadd(p, n)
+register struct PL_NODE *p, *n;
+{
+    register struct PL_NODE *k;
+
+    if (n->npar) {
+        snrem(n);
+    }
+    n->npar = p;
+    n->nsib = NULL;
+    if (p->nkid == NULL) {
+        p->nkid = n;
+    } else {
+        for (k = p->nkid; k->nsib; k = k->nsib);
+        k->nsib = n;
+    }
+    mark(n, SNDIRT);
+}
+
+snrem(n)
+register struct PL_NODE *n;
+{
+    register struct PL_NODE *p, *k;
+
+    p = n->npar;
+    if (p == NULL) {
+        return;
+    }
+    if (p->nkid == n) {
+        p->nkid = n->nsib;
+    } else {
+        for (k = p->nkid; k && (k->nsib != n); k = k->nsib);
+        if (k) {
+            k->nsib = n->nsib;
+        }
+    }
+    n->npar = NULL;
+    n->nsib = NULL;
+    mark(p, SNBND);
+}
+
+snset(n)
+register struct PL_NODE *n;
+{
+    extern mstget();
+
+    mstget(n->nloc);
+    mark(n, SNDIRT);
+}
+
+snobj(n, o)
+register struct PL_NODE *n;
+struct PL_OBJ *o;
+{
+    n->nobj = o;
+    mark(n, SNBND);
+}
+
+sndraw(n)
+struct PL_NODE *n;
+{
+    extern mstpush(), mstpop();
+    register struct PL_NODE *r;
+
+    /* the world matrix of the node depends on its ancestors, so update
+     * from the root, that also keeps the flags of the tree right */
+    for (r = n; r->npar; r = r->npar);
+    mstpush();
+    snupd(r, NULL, 0);
+    sndrn(n, 0);
+    mstpop();
+}
@@ -0,0 +1,145 @@
+/*****************************************************************************/
+/*
+ * Early C implementation of an extra lite version of the PiSHi engine.
+ * 
+ *   by EMMIR 2018-2022
+ *   
+ *   YouTube: https://www.youtube.com/c/LMP88
+ *   
+ * This software is released into the public domain.
+ */
+/*****************************************************************************/
+
+#include "pl.h"
+
+/*  tex.c
+ * 
+ * Texture cache. Textures that have a loader get their texel data
+ * brought into memory the first time they are drawn and are evicted,
+ * least recently used first, when the budget would be exceeded.
+ * 
+ */
+
+tcbudg 04000000; /* 16 textures */
+tcused 0;
+tchits 0;
+tcmiss 0;
+
+static frame 0;
+
+/* most and least recently used resident textures */
+static struct PL_TEX *mru NULL;
+static struct PL_TEX *lru NULL;
+
+static
+detach(t)
+register struct PL_TEX *t;
+{
+    if (t->txprev) {
+        t->txprev->txnext = t->txnext;
+    } else {
+        mru = t->txnext;
+    }
+    if (t->txnext) {
+        t->txnext->txprev = t->txprev;
+    } else {
+        lru = t->txprev;
+    }
+    t->txprev = NULL;
+    t->txnext = NULL;
+}
+
+static
+attach(t)
+register struct PL_TEX *t;
+{
+    t->txprev = NULL;
+    t->txnext = mru;
+    if (mru) {
+        mru->txprev = t;
+    } else {
+        lru = t;
+    }
+    mru = t;
+}
+
+/* evict until there is room for 'need' more bytes.
+ * textures used during the current frame are only evicted
+ * when nothing else is left to evict.
+ */
+static
+evict(need)
+{
+    register struct PL_TEX *t, *p;
+    int pass;
+
+    for (pass = 0; pass < 2; pass++) {
+        t = lru;
+        while (t && ((tcused + need) > tcbudg)) {
+            p = t->txprev;
+            if (pass || (t->txlast != frame)) {
+                tcdel(t);
+            }
+            t = p;
+        }
+    }
+}
+
+extern int *
+tcuse(t)
+register struct PL_TEX *t;
+{
+    extern char *umemgt();
+    extern umemfr(), uerror();
+    extern int umemtg();
+    register int tag;
+
+    if (t->txload == NULL) {
+        return(t->texdat);
+    }
+    t->txlast = frame;
+    if (t->texdat) {
+        tchits++;
+        if (t != mru) {
+            detach(t);
+            attach(t);
+        }
+        return(t->texdat);
+    }
+    tcmiss++;
+    evict(PTSIZE);
+    tag = umemtg(PMTEX);
+    t->texdat = umemgt(PTDIM * PTDIM, sizeof(int));
+    umemtg(tag);
+    if (t->texdat == NULL) {
+        uerror(PERR_NO_MEM, "tex", "no memory");
+        return(NULL);
+    }
+    if (!(*t->txload)(t, t->texdat)) {
+        umemfr(t->texdat);
+        t->texdat = NULL;
+        return(NULL);
+    }
+    tcused =+ PTSIZE;
+    attach(t);
+    return(t->texdat);
+}
+
+tcdel(t)
+register struct PL_TEX *t;
+{
+    extern umemfr();
+
+    if ((t->txload == NULL) || (t->texdat == NULL)) {
+        return;
+    }
+    detach(t);
+    umemfr(t->texdat);
+    t->texdat = NULL;
+    tcused =- PTSIZE;
+}
+
+tcfrm()
+{
+    frame++;
+}